@@ -29,6 +29,7 @@
 #define picojson_h
 
 #include <algorithm>
+#include <cerrno>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -37,10 +38,14 @@
 #include <iterator>
 #include <limits>
 #include <map>
+#include <new>
 #include <stdexcept>
 #include <string>
 #include <vector>
 #include <utility>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
 
 // for isnan/isinf
 #if __cplusplus >= 201103L
@@ -57,6 +62,26 @@ extern "C" {
 }
 #endif
 
+// for uint64_t
+#if __cplusplus >= 201103L
+#include <cstdint>
+#else
+extern "C" {
+#include <stdint.h>
+}
+#endif
+
+// the fast path of number conversion requires arithmetic on doubles to be performed in double precision
+#include <cfloat>
+#ifndef PICOJSON_USE_FAST_DOUBLE
+#if (defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0) || (defined(__FLT_EVAL_METHOD__) && __FLT_EVAL_METHOD__ == 0) ||              \
+    defined(_M_X64) || defined(_M_ARM64)
+#define PICOJSON_USE_FAST_DOUBLE 1
+#else
+#define PICOJSON_USE_FAST_DOUBLE 0
+#endif
+#endif
+
 #ifndef PICOJSON_USE_RVALUE_REFERENCE
 #if (defined(__cpp_rvalue_references) && __cpp_rvalue_references >= 200610) || (defined(_MSC_VER) && _MSC_VER >= 1600)
 #define PICOJSON_USE_RVALUE_REFERENCE 1
@@ -86,6 +111,28 @@ extern "C" {
 #endif
 #endif
 
+// the container of value::object; std::map (default), picojson::hash_map, picojson::flat_map, picojson::sorted_flat_map or
+// any other template with the interface of std::map
+#ifndef PICOJSON_OBJECT_MAP
+#define PICOJSON_OBJECT_MAP std::map
+#endif
+
+// to store strings of up to 8 bytes inside value instead of allocating a std::string, set PICOJSON_USE_SHORT_STRING to 1;
+// the const get<std::string>() then returns a copy of the chars instead of a reference, and the non-const one moves a short
+// string to the heap
+#ifndef PICOJSON_USE_SHORT_STRING
+#define PICOJSON_USE_SHORT_STRING 0
+#endif
+
+// to make value 8 bytes by storing the type and pointers in the payload of NaNs, set PICOJSON_USE_NAN_BOXING to 1; this
+// requires a little-endian target whose pointers fit in 48 bits, and int64 values (PICOJSON_USE_INT64) are then allocated
+#ifndef PICOJSON_USE_NAN_BOXING
+#define PICOJSON_USE_NAN_BOXING 0
+#endif
+#if PICOJSON_USE_NAN_BOXING && defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "PICOJSON_USE_NAN_BOXING requires a little-endian target"
+#endif
+
 // to disable the use of localeconv(3), set PICOJSON_USE_LOCALE to 0
 #ifndef PICOJSON_USE_LOCALE
 #define PICOJSON_USE_LOCALE 1
@@ -96,6 +143,60 @@ extern "C" {
 }
 #endif
 
+// SIMD scanning of contiguous input; set PICOJSON_USE_SSE2 / PICOJSON_USE_AVX2 to 0 to use the scalar code
+#ifndef PICOJSON_USE_SSE2
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PICOJSON_USE_SSE2 1
+#else
+#define PICOJSON_USE_SSE2 0
+#endif
+#endif
+#ifndef PICOJSON_USE_AVX2
+#if defined(__AVX2__)
+#define PICOJSON_USE_AVX2 1
+#else
+#define PICOJSON_USE_AVX2 0
+#endif
+#endif
+#if PICOJSON_USE_AVX2
+#include <immintrin.h>
+#elif PICOJSON_USE_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// parse_ndjson, parse_parallel and serialize_parallel, which use multiple threads; requires C++11, and on some platforms
+// linking with -pthread
+#ifndef PICOJSON_USE_THREADS
+#define PICOJSON_USE_THREADS 0
+#endif
+#if PICOJSON_USE_THREADS
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#endif
+
+// to use fd_sink and parse_fd, which write to and read from a file descriptor, and to let parse_file map the file into memory,
+// set PICOJSON_USE_POSIX to 1; the POSIX headers, including those for mmap, are included only then
+#ifndef PICOJSON_USE_POSIX
+#define PICOJSON_USE_POSIX 0
+#endif
+#if PICOJSON_USE_POSIX
+extern "C" {
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+}
+#endif
+
 #ifndef PICOJSON_ASSERT
 #define PICOJSON_ASSERT(e)                                                                                                         \
   do {                                                                                                                             \
@@ -134,10 +235,551 @@ enum { INDENT_WIDTH = 2, DEFAULT_MAX_DEPTHS = 100 };
 
 struct null {};
 
+// throws std::overflow_error for NaN and the infinities, which JSON cannot represent (as value(double) does)
+inline void _check_finite(double n) {
+  if (
+#ifdef _MSC_VER
+      !_finite(n)
+#elif __cplusplus >= 201103L
+      std::isnan(n) || std::isinf(n)
+#else
+      isnan(n) || isinf(n)
+#endif
+          ) {
+    throw std::overflow_error("");
+  }
+}
+
+// a range of chars, as returned by value::get_string_view()
+class string_view {
+  const char *data_;
+  size_t size_;
+
+public:
+  string_view() : data_(""), size_(0) {
+  }
+  string_view(const char *data, size_t size) : data_(data), size_(size) {
+  }
+  string_view(const char *s) : data_(s), size_(strlen(s)) {
+  }
+  string_view(const std::string &s) : data_(s.data()), size_(s.size()) {
+  }
+  const char *data() const {
+    return data_;
+  }
+  size_t size() const {
+    return size_;
+  }
+  bool empty() const {
+    return size_ == 0;
+  }
+  const char *begin() const {
+    return data_;
+  }
+  const char *end() const {
+    return data_ + size_;
+  }
+  char operator[](size_t i) const {
+    return data_[i];
+  }
+  std::string str() const {
+    return std::string(data_, size_);
+  }
+#if __cplusplus >= 201703L
+  operator std::string_view() const {
+    return std::string_view(data_, size_);
+  }
+#endif
+};
+
+inline bool operator==(const string_view &x, const string_view &y) {
+  return x.size() == y.size() && std::equal(x.begin(), x.end(), y.begin());
+}
+
+inline bool operator!=(const string_view &x, const string_view &y) {
+  return !(x == y);
+}
+
+// monotonic allocator; memory handed out is released all at once when the arena is destroyed or release() is called
+class arena {
+  struct block {
+    block *next;
+  };
+  enum {
+    ALIGN = sizeof(double) > sizeof(void *) ? sizeof(double) : sizeof(void *),
+    HEADER_SIZE = (sizeof(block) + ALIGN - 1) / ALIGN * ALIGN,
+    MIN_BLOCK_SIZE = 4096,
+    MAX_BLOCK_SIZE = 1024 * 1024
+  };
+  block *blocks_;
+  char *cur_;
+  char *end_;
+  size_t next_size_;
+
+public:
+  arena() : blocks_(NULL), cur_(NULL), end_(NULL), next_size_(MIN_BLOCK_SIZE) {
+  }
+  ~arena() {
+    release();
+  }
+  void *allocate(size_t n) {
+    n = (n + ALIGN - 1) / ALIGN * ALIGN;
+    if (static_cast<size_t>(end_ - cur_) < n)
+      _grow(n);
+    void *p = cur_;
+    cur_ += n;
+    return p;
+  }
+  void release() {
+    while (blocks_ != NULL) {
+      block *b = blocks_;
+      blocks_ = b->next;
+      ::operator delete(b);
+    }
+    cur_ = end_ = NULL;
+    next_size_ = MIN_BLOCK_SIZE;
+  }
+
+private:
+  void _grow(size_t n) {
+    size_t size = next_size_;
+    if (size < HEADER_SIZE + n)
+      size = HEADER_SIZE + n;
+    block *b = static_cast<block *>(::operator new(size));
+    b->next = blocks_;
+    blocks_ = b;
+    cur_ = reinterpret_cast<char *>(b) + HEADER_SIZE;
+    end_ = reinterpret_cast<char *>(b) + size;
+    if (next_size_ < MAX_BLOCK_SIZE)
+      next_size_ *= 2;
+  }
+  arena(const arena &);
+  arena &operator=(const arena &);
+};
+
+// std::map-like containers that may be selected for value::object through PICOJSON_OBJECT_MAP; the entries are kept in a
+// vector, so inserting a key may invalidate iterators and references to the values
+template <typename Key, typename T, typename Index> class basic_flat_map {
+public:
+  typedef Key key_type;
+  typedef T mapped_type;
+  typedef std::pair<Key, T> value_type;
+  typedef typename std::vector<value_type>::iterator iterator;
+  typedef typename std::vector<value_type>::const_iterator const_iterator;
+  typedef typename std::vector<value_type>::size_type size_type;
+
+protected:
+  std::vector<value_type> items_;
+  Index index_;
+
+public:
+  iterator begin() {
+    return items_.begin();
+  }
+  const_iterator begin() const {
+    return items_.begin();
+  }
+  iterator end() {
+    return items_.end();
+  }
+  const_iterator end() const {
+    return items_.end();
+  }
+  bool empty() const {
+    return items_.empty();
+  }
+  size_type size() const {
+    return items_.size();
+  }
+  void clear() {
+    items_.clear();
+    index_.clear();
+  }
+  void swap(basic_flat_map &x) {
+    items_.swap(x.items_);
+    index_.swap(x.index_);
+  }
+  iterator find(const Key &k) {
+    std::pair<size_t, bool> r = index_.lookup(items_, k);
+    return r.second ? items_.begin() + r.first : items_.end();
+  }
+  const_iterator find(const Key &k) const {
+    std::pair<size_t, bool> r = index_.lookup(items_, k);
+    return r.second ? items_.begin() + r.first : items_.end();
+  }
+  size_type count(const Key &k) const {
+    return index_.lookup(items_, k).second ? 1 : 0;
+  }
+  T &at(const Key &k) {
+    iterator i = find(k);
+    if (i == end())
+      throw std::out_of_range("picojson: no such key");
+    return i->second;
+  }
+  const T &at(const Key &k) const {
+    const_iterator i = find(k);
+    if (i == end())
+      throw std::out_of_range("picojson: no such key");
+    return i->second;
+  }
+  std::pair<iterator, bool> insert(const value_type &x) {
+    std::pair<size_t, bool> r = index_.lookup(items_, x.first);
+    if (!r.second) {
+      items_.insert(items_.begin() + r.first, x);
+      index_.inserted(items_, r.first);
+    }
+    return std::make_pair(items_.begin() + r.first, !r.second);
+  }
+  T &operator[](const Key &k) {
+    std::pair<size_t, bool> r = index_.lookup(items_, k);
+    if (!r.second) {
+      if (items_.empty())
+        items_.reserve(4);
+      items_.insert(items_.begin() + r.first, value_type(k, T()));
+      index_.inserted(items_, r.first);
+    }
+    return items_[r.first].second;
+  }
+  iterator erase(iterator i) {
+    size_t pos = i - items_.begin();
+    index_.erasing(items_, pos);
+    items_.erase(i);
+    return items_.begin() + pos;
+  }
+  size_type erase(const Key &k) {
+    iterator i = find(k);
+    if (i == end())
+      return 0;
+    erase(i);
+    return 1;
+  }
+};
+
+// keys are compared as a set, as the order of the entries depends on the container
+template <typename Key, typename T, typename Index>
+inline bool operator==(const basic_flat_map<Key, T, Index> &x, const basic_flat_map<Key, T, Index> &y) {
+  if (x.size() != y.size())
+    return false;
+  for (typename basic_flat_map<Key, T, Index>::const_iterator i = x.begin(); i != x.end(); ++i) {
+    typename basic_flat_map<Key, T, Index>::const_iterator j = y.find(i->first);
+    if (j == y.end() || !(j->second == i->second))
+      return false;
+  }
+  return true;
+}
+
+template <typename Key, typename T, typename Index>
+inline bool operator!=(const basic_flat_map<Key, T, Index> &x, const basic_flat_map<Key, T, Index> &y) {
+  return !(x == y);
+}
+
+// entries in insertion order, looked up by linear search
+struct _linear_index {
+  template <typename Items, typename Key> std::pair<size_t, bool> lookup(const Items &items, const Key &k) const {
+    for (size_t i = 0; i != items.size(); ++i)
+      if (items[i].first == k)
+        return std::make_pair(i, true);
+    return std::make_pair(items.size(), false);
+  }
+  template <typename Items> void inserted(const Items &, size_t) {
+  }
+  template <typename Items> void erasing(const Items &, size_t) {
+  }
+  void clear() {
+  }
+  void swap(_linear_index &) {
+  }
+};
+
+// entries sorted by key, looked up by binary search
+struct _sorted_index {
+  template <typename Items, typename Key> std::pair<size_t, bool> lookup(const Items &items, const Key &k) const {
+    size_t lo = 0, hi = items.size();
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+      if (items[mid].first < k) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return std::make_pair(lo, lo != items.size() && !(k < items[lo].first));
+  }
+  template <typename Items> void inserted(const Items &, size_t) {
+  }
+  template <typename Items> void erasing(const Items &, size_t) {
+  }
+  void clear() {
+  }
+  void swap(_sorted_index &) {
+  }
+};
+
+inline size_t _hash_key(const char *s, size_t len) {
+  // FNV-1a
+  uint64_t h = 14695981039346656037ULL;
+  for (const char *end = s + len; s != end; ++s) {
+    h ^= static_cast<unsigned char>(*s);
+    h *= 1099511628211ULL;
+  }
+  return static_cast<size_t>(h ^ (h >> 32));
+}
+
+inline size_t _hash_key(const std::string &s) {
+  return _hash_key(s.data(), s.size());
+}
+
+// entries in insertion order, looked up through an open-addressing table of indices once there are more than
+// LINEAR_MAX of them
+class _hash_index {
+  enum { LINEAR_MAX = 8 };
+  std::vector<size_t> slots_; // 1 + index into the entries, or 0 if empty; the size is a power of 2
+
+public:
+  template <typename Items, typename Key> std::pair<size_t, bool> lookup(const Items &items, const Key &k) const {
+    if (slots_.empty())
+      return _linear_index().lookup(items, k);
+    size_t mask = slots_.size() - 1;
+    for (size_t i = _hash_key(k) & mask;; i = (i + 1) & mask) {
+      size_t s = slots_[i];
+      if (s == 0)
+        return std::make_pair(items.size(), false);
+      if (items[s - 1].first == k)
+        return std::make_pair(s - 1, true);
+    }
+  }
+  template <typename Items> void inserted(const Items &items, size_t pos) {
+    if (items.size() <= LINEAR_MAX)
+      return;
+    if (items.size() * 4 > slots_.size() * 3) {
+      _rebuild(items);
+    } else {
+      _place(items, pos);
+    }
+  }
+  // called before the entry at pos is removed from items; the slot is freed by backward-shift deletion, so no tombstones
+  // are left behind, and the indices of the entries after pos are renumbered without rehashing
+  template <typename Items> void erasing(const Items &items, size_t pos) {
+    if (slots_.empty())
+      return;
+    if (items.size() - 1 <= LINEAR_MAX) {
+      slots_.clear();
+      return;
+    }
+    size_t mask = slots_.size() - 1, i = _hash_key(items[pos].first) & mask;
+    while (slots_[i] != pos + 1)
+      i = (i + 1) & mask;
+    for (size_t j = (i + 1) & mask; slots_[j] != 0; j = (j + 1) & mask) {
+      // the entry in slot j may move to the hole at i unless its home slot lies cyclically in (i, j]
+      size_t home = _hash_key(items[slots_[j] - 1].first) & mask;
+      if (i <= j ? (home <= i || j < home) : (home <= i && j < home)) {
+        slots_[i] = slots_[j];
+        i = j;
+      }
+    }
+    slots_[i] = 0;
+    if (pos + 1 != items.size()) {
+      for (std::vector<size_t>::iterator s = slots_.begin(); s != slots_.end(); ++s)
+        if (*s > pos + 1)
+          --*s;
+    }
+  }
+  void clear() {
+    slots_.clear();
+  }
+  void swap(_hash_index &x) {
+    slots_.swap(x.slots_);
+  }
+
+private:
+  template <typename Items> void _place(const Items &items, size_t pos) {
+    size_t mask = slots_.size() - 1;
+    size_t i = _hash_key(items[pos].first) & mask;
+    while (slots_[i] != 0)
+      i = (i + 1) & mask;
+    slots_[i] = pos + 1;
+  }
+  template <typename Items> void _rebuild(const Items &items) {
+    size_t n = LINEAR_MAX * 4;
+    while (n < items.size() * 2)
+      n *= 2;
+    slots_.assign(n, 0);
+    for (size_t pos = 0; pos != items.size(); ++pos)
+      _place(items, pos);
+  }
+};
+
+template <typename Key, typename T> class flat_map : public basic_flat_map<Key, T, _linear_index> {};
+template <typename Key, typename T> class sorted_flat_map : public basic_flat_map<Key, T, _sorted_index> {};
+template <typename Key, typename T> class hash_map : public basic_flat_map<Key, T, _hash_index> {};
+
+// a set of short strings that are stored once and never freed, so that the string values which repeat across documents can
+// refer to them (see parse(value &, first, last, string_pool &, err)); the pool must outlive those values, while their copies
+// own their chars.  intern() is thread-safe if PICOJSON_USE_THREADS is set: a string that is in the pool is found without a
+// lock, and only adding one takes it
+class string_pool {
+#if PICOJSON_USE_THREADS
+  typedef std::atomic<const char *> _slot;
+#else
+  typedef const char *_slot;
+#endif
+  // open addressing; a slot is NULL if empty, or points to the length of a string (a size_t) followed by its chars.  A table
+  // that is replaced when growing is kept until the pool is destroyed, as a lookup may still be reading it
+  struct _table {
+    size_t mask;
+    _slot *slots;
+  };
+  arena chars_;
+  std::vector<_table *> tables_;
+#if PICOJSON_USE_THREADS
+  std::atomic<_table *> table_;
+  std::mutex mutex_;
+#else
+  _table *table_;
+#endif
+  size_t size_;
+  size_t max_length_;
+  size_t max_size_;
+
+public:
+  // strings longer than max_length are not pooled, nor are new strings once the pool holds max_size of them
+  explicit string_pool(size_t max_length = 32, size_t max_size = 65536)
+      : chars_(), tables_(), table_(NULL), size_(0), max_length_(max_length), max_size_(max_size) {
+  }
+  ~string_pool() {
+    for (size_t i = 0; i != tables_.size(); ++i) {
+      delete[] tables_[i]->slots;
+      delete tables_[i];
+    }
+  }
+  size_t max_length() const {
+    return max_length_;
+  }
+  // the number of strings in the pool
+  size_t size() const {
+    return size_;
+  }
+  // sets out to the pooled copy of [s, s + len), adding it if necessary; returns false if the string is not pooled
+  bool intern(const char *s, size_t len, string_view &out) {
+    if (len > max_length_)
+      return false;
+    if (len == 0) {
+      out = string_view();
+      return true;
+    }
+    size_t hash = _hash_key(s, len), i;
+    if (_find(_load(table_), s, len, hash, out, i))
+      return true;
+#if PICOJSON_USE_THREADS
+    std::unique_lock<std::mutex> lock(mutex_);
+#endif
+    // the string may have been added, or the table replaced, meanwhile
+    _table *t = _load(table_);
+    if (_find(t, s, len, hash, out, i))
+      return true;
+    if (size_ >= max_size_)
+      return false;
+    if (t == NULL || (size_ + 1) * 4 > (t->mask + 1) * 3) {
+      t = _rehash(t);
+      for (i = hash & t->mask; _load(t->slots[i]) != NULL; i = (i + 1) & t->mask)
+        ;
+    }
+    char *p = static_cast<char *>(chars_.allocate(sizeof(size_t) + len));
+    memcpy(p, &len, sizeof(size_t));
+    memcpy(p + sizeof(size_t), s, len);
+    _store(t->slots[i], const_cast<const char *>(p));
+    ++size_;
+    out = string_view(p + sizeof(size_t), len);
+    return true;
+  }
+
+private:
+#if PICOJSON_USE_THREADS
+  template <typename T> static T _load(const std::atomic<T> &x) {
+    return x.load(std::memory_order_acquire);
+  }
+  template <typename T> static void _store(std::atomic<T> &x, T v) {
+    x.store(v, std::memory_order_release);
+  }
+#else
+  template <typename T> static T _load(T x) {
+    return x;
+  }
+  template <typename T> static void _store(T &x, T v) {
+    x = v;
+  }
+#endif
+  // returns true and sets out if found; otherwise sets i to the empty slot that ends the probe
+  static bool _find(const _table *t, const char *s, size_t len, size_t hash, string_view &out, size_t &i) {
+    if (t == NULL)
+      return false;
+    for (i = hash & t->mask;; i = (i + 1) & t->mask) {
+      const char *p = _load(t->slots[i]);
+      if (p == NULL)
+        return false;
+      size_t plen;
+      memcpy(&plen, p, sizeof(size_t));
+      if (plen == len && memcmp(p + sizeof(size_t), s, len) == 0) {
+        out = string_view(p + sizeof(size_t), len);
+        return true;
+      }
+    }
+  }
+  // called with the lock held; the new table is filled before it is published
+  _table *_rehash(const _table *old) {
+    size_t n = old == NULL ? 64 : (old->mask + 1) * 2;
+    _table *t = new _table;
+    t->mask = n - 1;
+    t->slots = new _slot[n]();
+    tables_.push_back(t);
+    if (old != NULL) {
+      for (size_t j = 0; j <= old->mask; ++j) {
+        const char *p = _load(old->slots[j]);
+        if (p != NULL) {
+          size_t plen, i;
+          memcpy(&plen, p, sizeof(size_t));
+          for (i = _hash_key(p + sizeof(size_t), plen) & t->mask; _load(t->slots[i]) != NULL; i = (i + 1) & t->mask)
+            ;
+          _store(t->slots[i], p);
+        }
+      }
+    }
+    _store(table_, t);
+    return t;
+  }
+  string_pool(const string_pool &);
+  string_pool &operator=(const string_pool &);
+};
+
+// the type returned by the const value::get<T>()
+template <typename T> struct _get_result { typedef const T &type; };
+#if PICOJSON_USE_SHORT_STRING
+template <> struct _get_result<std::string> { typedef std::string type; };
+#endif
+
 class value {
+  friend class default_parse_context;
+  friend class insitu_parse_context;
+  friend class _serialize_job;
+  template <typename Sink> friend class writer;
+
 public:
   typedef std::vector<value> array;
-  typedef std::map<std::string, value> object;
+  typedef PICOJSON_OBJECT_MAP<std::string, value> object;
+#if PICOJSON_USE_NAN_BOXING
+  union _storage {
+    bool boolean_;
+    double number_;
+    uint64_t bits_;
+  };
+
+protected:
+  // a double, or a NaN whose top 16 bits are 0xfff8 | tag and whose low 48 bits hold an immediate value or a pointer; bit 0
+  // of a pointer is set if the pointee is placement-constructed in an arena.  An int64 is always allocated, so that the const
+  // get<int64_t>() can return a reference to it without modifying the value
+  enum { _tag_boolean = 1, _tag_null, _tag_string, _tag_array, _tag_object, _tag_int64, _tag_short };
+  _storage u_;
+#else
   union _storage {
     bool boolean_;
     double number_;
@@ -147,15 +789,31 @@ public:
     std::string *string_;
     array *array_;
     object *object_;
+    const char *view_;
+    char short_[sizeof(double)]; // as large as the largest of the other members, so that it does not make the union larger
   };
 
 protected:
-  int type_;
+  enum {
+    _rep_heap,  // string_ / array_ / object_ is allocated by new
+    _rep_arena, // string_ / array_ / object_ is placement-constructed in an arena
+    _rep_short, // the string is stored in short_, its length in size_
+    _rep_view,  // the string is the chars at view_, which the value does not own; its length is size_
+    _rep_lazy,  // the array or object has not been parsed yet; its JSON text is at view_, and its length is size_
+    _rep_copied // like _rep_lazy, but the JSON text is a copy that the value owns, allocated by new[]
+  };
+  unsigned char type_;
+  unsigned char rep_;
+  bool plain_;            // the string is known to have no characters that are escaped when serialized
+  unsigned char depths_; // the nesting depth left to an unparsed array or object, itself included
+  uint32_t size_;
   _storage u_;
+#endif
 
 public:
   value();
   value(int type, bool);
+  value(int type, arena &a);
   explicit value(bool b);
 #ifdef PICOJSON_USE_INT64
   explicit value(int64_t i);
@@ -171,6 +829,8 @@ public:
 #endif
   explicit value(const char *s);
   value(const char *s, size_t len);
+  value(const char *s, size_t len, arena &a);
+  explicit value(const string_view &s);
   ~value();
   value(const value &x);
   value &operator=(const value &x);
@@ -180,12 +840,18 @@ public:
 #endif
   void swap(value &x) PICOJSON_NOEXCEPT;
   template <typename T> bool is() const;
-  template <typename T> const T &get() const;
+  // get<std::string>() on a view, get<double>() on an int64 and get<array>() or get<object>() on a lazy value convert the
+  // value on the first call, even through a const reference, so do not call them on a value that other threads are reading;
+  // get_string_view() and the other types never modify the value.  With PICOJSON_USE_SHORT_STRING, the const
+  // get<std::string>() returns a copy of the chars, as a short string has no std::string to refer to
+  template <typename T> typename _get_result<T>::type get() const;
   template <typename T> T &get();
   template <typename T> void set(const T &);
 #if PICOJSON_USE_RVALUE_REFERENCE
   template <typename T> void set(T &&);
 #endif
+  string_view get_string_view() const;
+  void detach();
   bool evaluate_as_boolean() const;
   const value &get(const size_t idx) const;
   const value &get(const std::string &key) const;
@@ -197,53 +863,383 @@ public:
   std::string to_str() const;
   template <typename Iter> void serialize(Iter os, bool prettify = false) const;
   std::string serialize(bool prettify = false) const;
+  template <typename Sink> void serialize_to(Sink &out, bool prettify = false) const;
+  size_t serialized_size(bool prettify = false) const;
+#if PICOJSON_USE_THREADS
+  template <typename Iter> void serialize_parallel(Iter os, bool prettify = false, size_t threads = 0) const;
+  std::string serialize_parallel(bool prettify = false, size_t threads = 0) const;
+#endif
 
 private:
   template <typename T> value(const T *); // intentionally defined to block implicit conversion of pointer to bool
-  template <typename Iter> static void _indent(Iter os, int indent);
-  template <typename Iter> void _serialize(Iter os, int indent) const;
+  template <typename Sink> static void _indent(Sink &out, int indent);
+  template <typename Sink> void _serialize(Sink &out, int indent) const;
+  template <typename Sink>
+  static void _serialize_items(Sink &out, array::const_iterator first, array::const_iterator last, bool comma, int indent);
+  template <typename Sink>
+  static void _serialize_members(Sink &out, object::const_iterator first, object::const_iterator last, bool comma, int indent);
   std::string _serialize(int indent) const;
+  int _type() const;
+  void _swap(value &x) PICOJSON_NOEXCEPT;
+  bool _in_arena() const;
+  void _init_string(const char *s, size_t len);
+  void _init_view(const string_view &s);
+  void _own_string();
+  void _check_plain();
+  void _set_plain(bool plain);
+  bool _plain() const;
+#ifdef PICOJSON_USE_INT64
+  int64_t _get_int64() const;
+#endif
   void clear();
+#if PICOJSON_USE_NAN_BOXING
+  static uint64_t _boxed(int tag, const void *p, bool in_arena);
+  int _tag() const;
+  template <typename T> T *_ptr() const;
+#ifdef PICOJSON_USE_INT64
+  void _init_int64(int64_t i);
+  void _int64_to_double();
+#endif
+#else
+  void _init_lazy(int type, const char *first, size_t len, size_t depths);
+  static void _parse_unparsed(value &out, const char *first, size_t len, int flags, size_t depths);
+  void _materialize();
+#endif
 };
 
 typedef value::array array;
 typedef value::object object;
 
-inline value::value() : type_(null_type), u_() {
+template <typename T> inline void _destroy(T *p) {
+  p->~T();
 }
 
-inline value::value(int type, bool) : type_(type), u_() {
-  switch (type) {
-#define INIT(p, v)                                                                                                                 \
-  case p##type:                                                                                                                    \
-    u_.p = v;                                                                                                                      \
-    break
-    INIT(boolean_, false);
-    INIT(number_, 0.0);
+#if PICOJSON_USE_NAN_BOXING
+
+inline uint64_t value::_boxed(int tag, const void *p, bool in_arena) {
+  uint64_t addr = reinterpret_cast<uintptr_t>(p);
+  PICOJSON_ASSERT("pointer does not fit in the payload of a NaN" && (addr & 0xffff000000000001ULL) == 0);
+  return 0xfff8000000000000ULL | (static_cast<uint64_t>(tag) << 48) | addr | (in_arena ? 1 : 0);
+}
+
+inline int value::_tag() const {
+  uint64_t top = u_.bits_ >> 48;
+  if (top > 0xfff8)
+    return static_cast<int>(top & 7);
+  return 0;
+}
+
+template <typename T> inline T *value::_ptr() const {
+  return reinterpret_cast<T *>(static_cast<uintptr_t>(u_.bits_ & 0xfffffffffffeULL));
+}
+
+inline int value::_type() const {
+  switch (_tag()) {
+  case _tag_null:
+    return null_type;
+  case _tag_boolean:
+    return boolean_type;
+  case _tag_string:
+  case _tag_short:
+    return string_type;
+  case _tag_array:
+    return array_type;
+  case _tag_object:
+    return object_type;
 #ifdef PICOJSON_USE_INT64
-    INIT(int64_, 0);
+  case _tag_int64:
+    return int64_type;
 #endif
-    INIT(string_, new std::string());
-    INIT(array_, new array());
-    INIT(object_, new object());
-#undef INIT
   default:
-    break;
+    return number_type;
   }
 }
 
-inline value::value(bool b) : type_(boolean_type), u_() {
-  u_.boolean_ = b;
+inline value::value() : u_() {
+  u_.bits_ = _boxed(_tag_null, NULL, false);
 }
 
+inline value::value(int type, bool) : u_() {
+  switch (type) {
+#define INIT(jtype, v)                                                                                                             \
+  case jtype##_type:                                                                                                               \
+    u_.bits_ = _boxed(_tag_##jtype, v, false);                                                                                     \
+    break
+    INIT(boolean, NULL);
+    INIT(string, new std::string());
+    INIT(array, new array());
+    INIT(object, new object());
+#undef INIT
 #ifdef PICOJSON_USE_INT64
-inline value::value(int64_t i) : type_(int64_type), u_() {
-  u_.int64_ = i;
-}
+  case int64_type:
+    _init_int64(0);
+    break;
 #endif
-
-inline value::value(double n) : type_(number_type), u_() {
-  if (
+  case number_type:
+    u_.number_ = 0.0;
+    break;
+  default:
+    u_.bits_ = _boxed(_tag_null, NULL, false);
+    break;
+  }
+}
+
+inline value::value(int type, arena &a) : u_() {
+  switch (type) {
+#define INIT(jtype, v)                                                                                                             \
+  case jtype##_type:                                                                                                               \
+    u_.bits_ = _boxed(_tag_##jtype, new (a.allocate(sizeof(v))) v(), true);                                                        \
+    break
+    INIT(string, std::string);
+    INIT(array, array);
+    INIT(object, object);
+#undef INIT
+  default: {
+    u_.bits_ = _boxed(_tag_null, NULL, false);
+    value v(type, false);
+    _swap(v);
+  } break;
+  }
+}
+
+inline value::value(bool b) : u_() {
+  u_.bits_ = _boxed(_tag_boolean, NULL, false) | (b ? 1 : 0);
+}
+
+#ifdef PICOJSON_USE_INT64
+inline value::value(int64_t i) : u_() {
+  _init_int64(i);
+}
+
+inline void value::_init_int64(int64_t i) {
+  u_.bits_ = _boxed(_tag_int64, new int64_t(i), false);
+}
+
+inline int64_t value::_get_int64() const {
+  return *_ptr<int64_t>();
+}
+#endif
+
+inline value::value(double n) : u_() {
+  if (
+#ifdef _MSC_VER
+      !_finite(n)
+#elif __cplusplus >= 201103L
+      std::isnan(n) || std::isinf(n)
+#else
+      isnan(n) || isinf(n)
+#endif
+          ) {
+    throw std::overflow_error("");
+  }
+  u_.number_ = n;
+}
+
+inline value::value(const std::string &s) : u_() {
+  _init_string(s.data(), s.size());
+}
+
+inline value::value(const array &a) : u_() {
+  u_.bits_ = _boxed(_tag_array, new array(a), false);
+}
+
+inline value::value(const object &o) : u_() {
+  u_.bits_ = _boxed(_tag_object, new object(o), false);
+}
+
+#if PICOJSON_USE_RVALUE_REFERENCE
+inline value::value(std::string &&s) : u_() {
+#if PICOJSON_USE_SHORT_STRING
+  if (s.size() <= sizeof(u_) - 2) {
+    _init_string(s.data(), s.size());
+    return;
+  }
+#endif
+  u_.bits_ = _boxed(_tag_string, new std::string(std::move(s)), false);
+}
+
+inline value::value(array &&a) : u_() {
+  u_.bits_ = _boxed(_tag_array, new array(std::move(a)), false);
+}
+
+inline value::value(object &&o) : u_() {
+  u_.bits_ = _boxed(_tag_object, new object(std::move(o)), false);
+}
+#endif
+
+inline value::value(const char *s) : u_() {
+  _init_string(s, strlen(s));
+}
+
+inline value::value(const char *s, size_t len) : u_() {
+  _init_string(s, len);
+}
+
+inline value::value(const char *s, size_t len, arena &a) : u_() {
+#if PICOJSON_USE_SHORT_STRING
+  if (len <= sizeof(u_) - 2) {
+    _init_string(s, len);
+    return;
+  }
+#endif
+  u_.bits_ = _boxed(_tag_string, new (a.allocate(sizeof(std::string))) std::string(s, len), true);
+}
+
+inline value::value(const string_view &s) : u_() {
+  _init_string(s.data(), s.size());
+}
+
+// a (pointer, length) pair does not fit in the payload, so the chars are copied
+inline void value::_init_view(const string_view &s) {
+  clear();
+  _init_string(s.data(), s.size());
+}
+
+// strings of up to 6 bytes that do not contain NUL are stored in the payload, padded with NULs
+inline void value::_init_string(const char *s, size_t len) {
+#if PICOJSON_USE_SHORT_STRING
+  if (len <= sizeof(u_) - 2 && std::find(s, s + len, '\0') == s + len) {
+    u_.bits_ = _boxed(_tag_short, NULL, false);
+    std::copy(s, s + len, reinterpret_cast<char *>(&u_.bits_));
+    return;
+  }
+#endif
+  u_.bits_ = _boxed(_tag_string, new std::string(s, len), false);
+}
+
+inline void value::_own_string() {
+  if (_tag() == _tag_short) {
+    string_view s = get_string_view();
+    u_.bits_ = _boxed(_tag_string, new std::string(s.data(), s.size()), false);
+  }
+}
+
+inline void value::clear() {
+  bool in_arena = (u_.bits_ & 1) != 0;
+  switch (_tag()) {
+#define DEINIT(jtype, t)                                                                                                           \
+  case _tag_##jtype:                                                                                                               \
+    if (in_arena) {                                                                                                                \
+      _destroy(_ptr<t>());                                                                                                         \
+    } else {                                                                                                                       \
+      delete _ptr<t>();                                                                                                            \
+    }                                                                                                                              \
+    break
+    DEINIT(string, std::string);
+    DEINIT(array, array);
+    DEINIT(object, object);
+#ifdef PICOJSON_USE_INT64
+    DEINIT(int64, int64_t);
+#endif
+#undef DEINIT
+  default:
+    break;
+  }
+  u_.bits_ = _boxed(_tag_null, NULL, false);
+}
+
+inline value::value(const value &x) : u_(x.u_) {
+  switch (x._tag()) {
+#define INIT(jtype, t)                                                                                                             \
+  case _tag_##jtype:                                                                                                               \
+    u_.bits_ = _boxed(_tag_##jtype, new t(*x._ptr<t>()), false);                                                                   \
+    break
+    INIT(array, array);
+    INIT(object, object);
+#ifdef PICOJSON_USE_INT64
+    INIT(int64, int64_t);
+#endif
+#undef INIT
+  case _tag_string: {
+    string_view s = x.get_string_view();
+    _init_string(s.data(), s.size());
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+#if PICOJSON_USE_RVALUE_REFERENCE
+inline value::value(value &&x) PICOJSON_NOEXCEPT : u_() {
+  u_.bits_ = _boxed(_tag_null, NULL, false);
+  _swap(x);
+}
+#endif
+
+inline void value::_swap(value &x) PICOJSON_NOEXCEPT {
+  std::swap(u_, x.u_);
+}
+
+inline bool value::_in_arena() const {
+  switch (_tag()) {
+  case _tag_string:
+  case _tag_array:
+  case _tag_object:
+    return (u_.bits_ & 1) != 0;
+  default:
+    return false;
+  }
+}
+
+#else
+
+inline int value::_type() const {
+  return type_;
+}
+
+inline value::value() : type_(null_type), rep_(_rep_heap), plain_(false), depths_(0), size_(0), u_() {
+}
+
+inline value::value(int type, bool) : type_(type), rep_(_rep_heap), plain_(false), depths_(0), size_(0), u_() {
+  switch (type) {
+#define INIT(p, v)                                                                                                                 \
+  case p##type:                                                                                                                    \
+    u_.p = v;                                                                                                                      \
+    break
+    INIT(boolean_, false);
+    INIT(number_, 0.0);
+#ifdef PICOJSON_USE_INT64
+    INIT(int64_, 0);
+#endif
+    INIT(string_, new std::string());
+    INIT(array_, new array());
+    INIT(object_, new object());
+#undef INIT
+  default:
+    break;
+  }
+}
+
+inline value::value(int type, arena &a) : type_(type), rep_(_rep_arena), plain_(false), depths_(0), size_(0), u_() {
+  switch (type) {
+#define INIT(p, v)                                                                                                                 \
+  case p##type:                                                                                                                    \
+    u_.p = new (a.allocate(sizeof(v))) v();                                                                                        \
+    break
+    INIT(string_, std::string);
+    INIT(array_, array);
+    INIT(object_, object);
+#undef INIT
+  default:
+    rep_ = _rep_heap;
+    u_ = value(type, false).u_;
+    break;
+  }
+}
+
+inline value::value(bool b) : type_(boolean_type), rep_(_rep_heap), plain_(false), depths_(0), size_(0), u_() {
+  u_.boolean_ = b;
+}
+
+#ifdef PICOJSON_USE_INT64
+inline value::value(int64_t i) : type_(int64_type), rep_(_rep_heap), plain_(false), depths_(0), size_(0), u_() {
+  u_.int64_ = i;
+}
+#endif
+
+inline value::value(double n) : type_(number_type), rep_(_rep_heap), plain_(false), depths_(0), size_(0), u_() {
+  if (
 #ifdef _MSC_VER
       !_finite(n)
 #elif __cplusplus >= 201103L
@@ -257,100 +1253,231 @@ inline value::value(double n) : type_(number_type), u_() {
   u_.number_ = n;
 }
 
-inline value::value(const std::string &s) : type_(string_type), u_() {
-  u_.string_ = new std::string(s);
+inline value::value(const std::string &s) : type_(string_type), rep_(_rep_heap), plain_(false), depths_(0), size_(0), u_() {
+  _init_string(s.data(), s.size());
 }
 
-inline value::value(const array &a) : type_(array_type), u_() {
+inline value::value(const array &a) : type_(array_type), rep_(_rep_heap), plain_(false), depths_(0), size_(0), u_() {
   u_.array_ = new array(a);
 }
 
-inline value::value(const object &o) : type_(object_type), u_() {
+inline value::value(const object &o) : type_(object_type), rep_(_rep_heap), plain_(false), depths_(0), size_(0), u_() {
   u_.object_ = new object(o);
 }
 
 #if PICOJSON_USE_RVALUE_REFERENCE
-inline value::value(std::string &&s) : type_(string_type), u_() {
+inline value::value(std::string &&s) : type_(string_type), rep_(_rep_heap), plain_(false), depths_(0), size_(0), u_() {
+#if PICOJSON_USE_SHORT_STRING
+  if (s.size() <= sizeof(u_.short_)) {
+    _init_string(s.data(), s.size());
+    return;
+  }
+#endif
   u_.string_ = new std::string(std::move(s));
 }
 
-inline value::value(array &&a) : type_(array_type), u_() {
+inline value::value(array &&a) : type_(array_type), rep_(_rep_heap), plain_(false), depths_(0), size_(0), u_() {
   u_.array_ = new array(std::move(a));
 }
 
-inline value::value(object &&o) : type_(object_type), u_() {
+inline value::value(object &&o) : type_(object_type), rep_(_rep_heap), plain_(false), depths_(0), size_(0), u_() {
   u_.object_ = new object(std::move(o));
 }
 #endif
 
-inline value::value(const char *s) : type_(string_type), u_() {
-  u_.string_ = new std::string(s);
+inline value::value(const char *s) : type_(string_type), rep_(_rep_heap), plain_(false), depths_(0), size_(0), u_() {
+  _init_string(s, strlen(s));
+}
+
+inline value::value(const char *s, size_t len) : type_(string_type), rep_(_rep_heap), plain_(false), depths_(0), size_(0), u_() {
+  _init_string(s, len);
+}
+
+inline value::value(const char *s, size_t len, arena &a)
+    : type_(string_type), rep_(_rep_arena), plain_(false), depths_(0), size_(0), u_() {
+#if PICOJSON_USE_SHORT_STRING
+  if (len <= sizeof(u_.short_)) {
+    rep_ = _rep_heap;
+    _init_string(s, len);
+    return;
+  }
+#endif
+  u_.string_ = new (a.allocate(sizeof(std::string))) std::string(s, len);
+}
+
+inline value::value(const string_view &s) : type_(string_type), rep_(_rep_heap), plain_(false), depths_(0), size_(0), u_() {
+  _init_string(s.data(), s.size());
+}
+
+// makes the value a string that refers to the chars of s, as parse_view() does; short strings are copied all the same
+inline void value::_init_view(const string_view &s) {
+  clear();
+  type_ = string_type;
+  if (s.size() > std::numeric_limits<uint32_t>::max()
+#if PICOJSON_USE_SHORT_STRING
+      || s.size() <= sizeof(u_.short_)
+#endif
+      ) {
+    _init_string(s.data(), s.size());
+    return;
+  }
+  rep_ = _rep_view;
+  u_.view_ = s.data();
+  size_ = static_cast<uint32_t>(s.size());
 }
 
-inline value::value(const char *s, size_t len) : type_(string_type), u_() {
+inline void value::_init_string(const char *s, size_t len) {
+#if PICOJSON_USE_SHORT_STRING
+  if (len <= sizeof(u_.short_)) {
+    std::copy(s, s + len, u_.short_);
+    size_ = static_cast<uint32_t>(len);
+    rep_ = _rep_short;
+    return;
+  }
+#endif
   u_.string_ = new std::string(s, len);
 }
 
+inline void value::_init_lazy(int type, const char *first, size_t len, size_t depths) {
+  clear();
+  type_ = static_cast<unsigned char>(type);
+  rep_ = _rep_lazy;
+  depths_ = static_cast<unsigned char>(depths);
+  u_.view_ = first;
+  size_ = static_cast<uint32_t>(len);
+}
+
+// moves a string held in place or referred to by a view to the heap, so that it can be accessed as std::string
+inline void value::_own_string() {
+  if (rep_ >= _rep_short) {
+    std::string *s = new std::string(get_string_view().str());
+    u_.string_ = s;
+    rep_ = _rep_heap;
+  }
+}
+
 inline void value::clear() {
-  switch (type_) {
+  switch (rep_) {
+  case _rep_heap:
+    switch (type_) {
 #define DEINIT(p)                                                                                                                  \
   case p##type:                                                                                                                    \
     delete u_.p;                                                                                                                   \
     break
-    DEINIT(string_);
-    DEINIT(array_);
-    DEINIT(object_);
+      DEINIT(string_);
+      DEINIT(array_);
+      DEINIT(object_);
+#undef DEINIT
+    default:
+      break;
+    }
+    break;
+  case _rep_arena:
+    switch (type_) {
+#define DEINIT(p)                                                                                                                  \
+  case p##type:                                                                                                                    \
+    _destroy(u_.p);                                                                                                                \
+    break
+      DEINIT(string_);
+      DEINIT(array_);
+      DEINIT(object_);
 #undef DEINIT
+    default:
+      break;
+    }
+    break;
+  case _rep_copied:
+    delete[] u_.view_;
+    break;
   default:
     break;
   }
+  rep_ = _rep_heap;
+  plain_ = false;
 }
 
-inline value::~value() {
-  clear();
-}
-
-inline value::value(const value &x) : type_(x.type_), u_() {
+// a copy owns all of its chars, even if x refers to the input of parse_view() or parse_lazy(); an array or object that has not
+// been parsed yet is copied as text, and parsed when the copy is first accessed
+inline value::value(const value &x) : type_(x.type_), rep_(_rep_heap), plain_(x.plain_), depths_(0), size_(0), u_() {
+  if (x.rep_ >= _rep_lazy) {
+    char *text = new char[x.size_];
+    std::copy(x.u_.view_, x.u_.view_ + x.size_, text);
+    rep_ = _rep_copied;
+    depths_ = x.depths_;
+    size_ = x.size_;
+    u_.view_ = text;
+    return;
+  }
   switch (type_) {
 #define INIT(p, v)                                                                                                                 \
   case p##type:                                                                                                                    \
     u_.p = v;                                                                                                                      \
     break
-    INIT(string_, new std::string(*x.u_.string_));
     INIT(array_, new array(*x.u_.array_));
     INIT(object_, new object(*x.u_.object_));
 #undef INIT
+  case string_type: {
+    string_view s = x.get_string_view();
+    _init_string(s.data(), s.size());
+    break;
+  }
   default:
     u_ = x.u_;
     break;
   }
 }
 
+#if PICOJSON_USE_RVALUE_REFERENCE
+inline value::value(value &&x) PICOJSON_NOEXCEPT : type_(null_type), rep_(_rep_heap), plain_(false), depths_(0), size_(0), u_() {
+  _swap(x);
+}
+#endif
+
+inline bool value::_in_arena() const {
+  return rep_ == _rep_arena;
+}
+
+inline void value::_swap(value &x) PICOJSON_NOEXCEPT {
+  std::swap(type_, x.type_);
+  std::swap(rep_, x.rep_);
+  std::swap(plain_, x.plain_);
+  std::swap(depths_, x.depths_);
+  std::swap(size_, x.size_);
+  std::swap(u_, x.u_);
+}
+
+#endif
+
+inline value::~value() {
+  clear();
+}
+
+inline void value::swap(value &x) PICOJSON_NOEXCEPT {
+  _swap(x);
+}
+
 inline value &value::operator=(const value &x) {
   if (this != &x) {
     value t(x);
-    swap(t);
+    _swap(t);
   }
   return *this;
 }
 
 #if PICOJSON_USE_RVALUE_REFERENCE
-inline value::value(value &&x) PICOJSON_NOEXCEPT : type_(null_type), u_() {
-  swap(x);
-}
 inline value &value::operator=(value &&x) PICOJSON_NOEXCEPT {
-  swap(x);
+  if (this != &x) {
+    value t(std::move(x));
+    _swap(t);
+  }
   return *this;
 }
 #endif
-inline void value::swap(value &x) PICOJSON_NOEXCEPT {
-  std::swap(type_, x.type_);
-  std::swap(u_, x.u_);
-}
+
 
 #define IS(ctype, jtype)                                                                                                           \
   template <> inline bool value::is<ctype>() const {                                                                               \
-    return type_ == jtype##_type;                                                                                                  \
+    return _type() == jtype##_type;                                                                                                \
   }
 IS(null, null)
 IS(bool, boolean)
@@ -362,9 +1489,10 @@ IS(array, array)
 IS(object, object)
 #undef IS
 template <> inline bool value::is<double>() const {
-  return type_ == number_type
+  int type = _type();
+  return type == number_type
 #ifdef PICOJSON_USE_INT64
-         || type_ == int64_type
+         || type == int64_type
 #endif
       ;
 }
@@ -379,62 +1507,213 @@ template <> inline bool value::is<double>() const {
     return var;                                                                                                                    \
   }
 GET(bool, u_.boolean_)
-GET(std::string, *u_.string_)
-GET(array, *u_.array_)
-GET(object, *u_.object_)
+#if PICOJSON_USE_NAN_BOXING
+#if PICOJSON_USE_SHORT_STRING
+template <> inline std::string value::get<std::string>() const {
+  PICOJSON_ASSERT("type mismatch! call is<type>() before get<type>()" && is<std::string>());
+  string_view s = get_string_view();
+  return std::string(s.data(), s.size());
+}
+template <> inline std::string &value::get<std::string>() {
+  PICOJSON_ASSERT("type mismatch! call is<type>() before get<type>()" && is<std::string>());
+  _own_string();
+  return *_ptr<std::string>();
+}
+#else
+GET(std::string, *_ptr<std::string>())
+#endif
+GET(array, *_ptr<array>())
+GET(object, *_ptr<object>())
 #ifdef PICOJSON_USE_INT64
-GET(double,
-    (type_ == int64_type && (const_cast<value *>(this)->type_ = number_type, (const_cast<value *>(this)->u_.number_ = u_.int64_)),
-     u_.number_))
-GET(int64_t, u_.int64_)
+GET(double, (_type() == int64_type && (const_cast<value *>(this)->_int64_to_double(), true), u_.number_))
+GET(int64_t, *_ptr<int64_t>())
 #else
 GET(double, u_.number_)
 #endif
 #undef GET
 
-#define SET(ctype, jtype, setter)                                                                                                  \
+#ifdef PICOJSON_USE_INT64
+inline void value::_int64_to_double() {
+  double n = static_cast<double>(_get_int64());
+  clear();
+  u_.number_ = n;
+}
+#endif
+
+#define SET(ctype, setter)                                                                                                         \
   template <> inline void value::set<ctype>(const ctype &_val) {                                                                   \
     clear();                                                                                                                       \
-    type_ = jtype##_type;                                                                                                          \
     setter                                                                                                                         \
   }
-SET(bool, boolean, u_.boolean_ = _val;)
-SET(std::string, string, u_.string_ = new std::string(_val);)
-SET(array, array, u_.array_ = new array(_val);)
-SET(object, object, u_.object_ = new object(_val);)
-SET(double, number, u_.number_ = _val;)
+SET(bool, u_.bits_ = _boxed(_tag_boolean, NULL, false) | (_val ? 1 : 0);)
+SET(std::string, _init_string(_val.data(), _val.size());)
+SET(array, u_.bits_ = _boxed(_tag_array, new array(_val), false);)
+SET(object, u_.bits_ = _boxed(_tag_object, new object(_val), false);)
+// a NaN stored through the setter must not be mistaken for a boxed value
+SET(double, u_.number_ = _val == _val ? _val : std::numeric_limits<double>::quiet_NaN();)
 #ifdef PICOJSON_USE_INT64
-SET(int64_t, int64, u_.int64_ = _val;)
+SET(int64_t, _init_int64(_val);)
 #endif
 #undef SET
 
 #if PICOJSON_USE_RVALUE_REFERENCE
-#define MOVESET(ctype, jtype, setter)                                                                                              \
+#define MOVESET(ctype, setter)                                                                                                     \
   template <> inline void value::set<ctype>(ctype && _val) {                                                                       \
     clear();                                                                                                                       \
-    type_ = jtype##_type;                                                                                                          \
     setter                                                                                                                         \
   }
-MOVESET(std::string, string, u_.string_ = new std::string(std::move(_val));)
-MOVESET(array, array, u_.array_ = new array(std::move(_val));)
-MOVESET(object, object, u_.object_ = new object(std::move(_val));)
+MOVESET(array, u_.bits_ = _boxed(_tag_array, new array(std::move(_val)), false);)
+MOVESET(object, u_.bits_ = _boxed(_tag_object, new object(std::move(_val)), false);)
 #undef MOVESET
 #endif
 
-inline bool value::evaluate_as_boolean() const {
-  switch (type_) {
-  case null_type:
-    return false;
-  case boolean_type:
-    return u_.boolean_;
-  case number_type:
-    return u_.number_ != 0;
-#ifdef PICOJSON_USE_INT64
-  case int64_type:
-    return u_.int64_ != 0;
-#endif
+inline string_view value::get_string_view() const {
+  PICOJSON_ASSERT("type mismatch! call is<type>() before get<type>()" && is<std::string>());
+  if (_tag() == _tag_short) {
+    const char *s = reinterpret_cast<const char *>(&u_.bits_);
+    return string_view(s, std::find(s, s + sizeof(u_) - 2, '\0') - s);
+  }
+  return *_ptr<std::string>();
+}
+
+inline bool value::_plain() const {
+  return false;
+}
+
+#else
+
+#if PICOJSON_USE_SHORT_STRING
+template <> inline std::string value::get<std::string>() const {
+  PICOJSON_ASSERT("type mismatch! call is<type>() before get<type>()" && is<std::string>());
+  string_view s = get_string_view();
+  return std::string(s.data(), s.size());
+}
+#else
+template <> inline const std::string &value::get<std::string>() const {
+  PICOJSON_ASSERT("type mismatch! call is<type>() before get<type>()" && is<std::string>());
+  if (rep_ >= _rep_short)
+    const_cast<value *>(this)->_own_string();
+  return *u_.string_;
+}
+#endif
+template <> inline std::string &value::get<std::string>() {
+  PICOJSON_ASSERT("type mismatch! call is<type>() before get<type>()" && is<std::string>());
+  _own_string();
+  plain_ = false; // the caller may modify the string
+  return *u_.string_;
+}
+GET(array, (rep_ >= _rep_lazy && (const_cast<value *>(this)->_materialize(), true), *u_.array_))
+GET(object, (rep_ >= _rep_lazy && (const_cast<value *>(this)->_materialize(), true), *u_.object_))
+#ifdef PICOJSON_USE_INT64
+GET(double,
+    (type_ == int64_type && (const_cast<value *>(this)->type_ = number_type, (const_cast<value *>(this)->u_.number_ = u_.int64_)),
+     u_.number_))
+GET(int64_t, u_.int64_)
+#else
+GET(double, u_.number_)
+#endif
+#undef GET
+
+#define SET(ctype, jtype, setter)                                                                                                  \
+  template <> inline void value::set<ctype>(const ctype &_val) {                                                                   \
+    clear();                                                                                                                       \
+    type_ = jtype##_type;                                                                                                          \
+    setter                                                                                                                         \
+  }
+SET(bool, boolean, u_.boolean_ = _val;)
+SET(std::string, string, _init_string(_val.data(), _val.size());)
+SET(array, array, u_.array_ = new array(_val);)
+SET(object, object, u_.object_ = new object(_val);)
+SET(double, number, u_.number_ = _val;)
+#ifdef PICOJSON_USE_INT64
+SET(int64_t, int64, u_.int64_ = _val;)
+#endif
+#undef SET
+
+#if PICOJSON_USE_RVALUE_REFERENCE
+#define MOVESET(ctype, jtype, setter)                                                                                              \
+  template <> inline void value::set<ctype>(ctype && _val) {                                                                       \
+    clear();                                                                                                                       \
+    type_ = jtype##_type;                                                                                                          \
+    setter                                                                                                                         \
+  }
+MOVESET(array, array, u_.array_ = new array(std::move(_val));)
+MOVESET(object, object, u_.object_ = new object(std::move(_val));)
+#undef MOVESET
+#endif
+
+inline string_view value::get_string_view() const {
+  PICOJSON_ASSERT("type mismatch! call is<type>() before get<type>()" && is<std::string>());
+  if (rep_ == _rep_short)
+    return string_view(u_.short_, size_);
+  if (rep_ == _rep_view)
+    return string_view(u_.view_, size_);
+  return *u_.string_;
+}
+
+inline bool value::_plain() const {
+  return plain_;
+}
+
+#ifdef PICOJSON_USE_INT64
+inline int64_t value::_get_int64() const {
+  return u_.int64_;
+}
+#endif
+
+#endif
+
+#if PICOJSON_USE_RVALUE_REFERENCE
+template <> inline void value::set<std::string>(std::string &&_val) {
+  value v(std::move(_val));
+  _swap(v);
+}
+#endif
+
+// copies the chars of the strings (including those of the descendants) that are views, so that the value no longer refers
+// to the buffer it was parsed from, and copies a string, array or object that is in the arena of a document to the heap
+inline void value::detach() {
+  if (_in_arena()) {
+    value t(*this);
+    _swap(t);
+    return;
+  }
+  switch (_type()) {
+#if !PICOJSON_USE_NAN_BOXING
+  case string_type:
+    if (rep_ == _rep_view)
+      _own_string();
+    break;
+#endif
+  case array_type: {
+    array &a = get<array>();
+    for (array::iterator i = a.begin(); i != a.end(); ++i)
+      i->detach();
+  } break;
+  case object_type: {
+    object &o = get<object>();
+    for (object::iterator i = o.begin(); i != o.end(); ++i)
+      i->second.detach();
+  } break;
+  default:
+    break;
+  }
+}
+
+inline bool value::evaluate_as_boolean() const {
+  switch (_type()) {
+  case null_type:
+    return false;
+  case boolean_type:
+    return get<bool>();
+  case number_type:
+    return get<double>() != 0;
+#ifdef PICOJSON_USE_INT64
+  case int64_type:
+    return _get_int64() != 0;
+#endif
   case string_type:
-    return !u_.string_->empty();
+    return !get_string_view().empty();
   default:
     return true;
   }
@@ -442,73 +1721,427 @@ inline bool value::evaluate_as_boolean() const {
 
 inline const value &value::get(const size_t idx) const {
   static value s_null;
-  PICOJSON_ASSERT(is<array>());
-  return idx < u_.array_->size() ? (*u_.array_)[idx] : s_null;
+  const array &a = get<array>();
+  return idx < a.size() ? a[idx] : s_null;
 }
 
 inline value &value::get(const size_t idx) {
   static value s_null;
-  PICOJSON_ASSERT(is<array>());
-  return idx < u_.array_->size() ? (*u_.array_)[idx] : s_null;
+  array &a = get<array>();
+  return idx < a.size() ? a[idx] : s_null;
 }
 
 inline const value &value::get(const std::string &key) const {
   static value s_null;
-  PICOJSON_ASSERT(is<object>());
-  object::const_iterator i = u_.object_->find(key);
-  return i != u_.object_->end() ? i->second : s_null;
+  const object &o = get<object>();
+  object::const_iterator i = o.find(key);
+  return i != o.end() ? i->second : s_null;
 }
 
 inline value &value::get(const std::string &key) {
   static value s_null;
-  PICOJSON_ASSERT(is<object>());
-  object::iterator i = u_.object_->find(key);
-  return i != u_.object_->end() ? i->second : s_null;
+  object &o = get<object>();
+  object::iterator i = o.find(key);
+  return i != o.end() ? i->second : s_null;
 }
 
 inline bool value::contains(const size_t idx) const {
-  PICOJSON_ASSERT(is<array>());
-  return idx < u_.array_->size();
+  return idx < get<array>().size();
 }
 
 inline bool value::contains(const std::string &key) const {
-  PICOJSON_ASSERT(is<object>());
-  object::const_iterator i = u_.object_->find(key);
-  return i != u_.object_->end();
+  const object &o = get<object>();
+  return o.find(key) != o.end();
+}
+
+// shortest representation of doubles that converts back to the same value (Grisu2, as described in Florian Loitsch,
+// "Printing Floating-Point Numbers Quickly and Accurately with Integers", PLDI 2010)
+struct diy_fp {
+  uint64_t f;
+  int e;
+  diy_fp(uint64_t f_, int e_) : f(f_), e(e_) {
+  }
+};
+
+inline diy_fp _diy_fp_mul(const diy_fp &x, const diy_fp &y) {
+  const uint64_t m32 = 0xffffffffu;
+  uint64_t a = x.f >> 32, b = x.f & m32, c = y.f >> 32, d = y.f & m32;
+  uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+  uint64_t mid = (bd >> 32) + (ad & m32) + (bc & m32) + (static_cast<uint64_t>(1) << 31); // rounds the lower half
+  return diy_fp(ac + (ad >> 32) + (bc >> 32) + (mid >> 32), x.e + y.e + 64);
+}
+
+inline diy_fp _diy_fp_normalize(diy_fp x) {
+  while ((x.f & (static_cast<uint64_t>(1) << 63)) == 0) {
+    x.f <<= 1;
+    --x.e;
+  }
+  return x;
+}
+
+// normalized approximations of 10^-348, 10^-340, ..., 10^340
+template <typename T> struct cached_power_t {
+  struct entry {
+    uint64_t f;
+    short e;
+  };
+  static const entry table[87];
+};
+template <typename T> const typename cached_power_t<T>::entry cached_power_t<T>::table[87] = {
+    {0xfa8fd5a0081c0288ULL, -1220}, {0xbaaee17fa23ebf76ULL, -1193}, {0x8b16fb203055ac76ULL, -1166},
+    {0xcf42894a5dce35eaULL, -1140}, {0x9a6bb0aa55653b2dULL, -1113}, {0xe61acf033d1a45dfULL, -1087},
+    {0xab70fe17c79ac6caULL, -1060}, {0xff77b1fcbebcdc4fULL, -1034}, {0xbe5691ef416bd60cULL, -1007},
+    {0x8dd01fad907ffc3cULL, -980}, {0xd3515c2831559a83ULL, -954}, {0x9d71ac8fada6c9b5ULL, -927},
+    {0xea9c227723ee8bcbULL, -901}, {0xaecc49914078536dULL, -874}, {0x823c12795db6ce57ULL, -847},
+    {0xc21094364dfb5637ULL, -821}, {0x9096ea6f3848984fULL, -794}, {0xd77485cb25823ac7ULL, -768},
+    {0xa086cfcd97bf97f4ULL, -741}, {0xef340a98172aace5ULL, -715}, {0xb23867fb2a35b28eULL, -688},
+    {0x84c8d4dfd2c63f3bULL, -661}, {0xc5dd44271ad3cdbaULL, -635}, {0x936b9fcebb25c996ULL, -608},
+    {0xdbac6c247d62a584ULL, -582}, {0xa3ab66580d5fdaf6ULL, -555}, {0xf3e2f893dec3f126ULL, -529},
+    {0xb5b5ada8aaff80b8ULL, -502}, {0x87625f056c7c4a8bULL, -475}, {0xc9bcff6034c13053ULL, -449},
+    {0x964e858c91ba2655ULL, -422}, {0xdff9772470297ebdULL, -396}, {0xa6dfbd9fb8e5b88fULL, -369},
+    {0xf8a95fcf88747d94ULL, -343}, {0xb94470938fa89bcfULL, -316}, {0x8a08f0f8bf0f156bULL, -289},
+    {0xcdb02555653131b6ULL, -263}, {0x993fe2c6d07b7facULL, -236}, {0xe45c10c42a2b3b06ULL, -210},
+    {0xaa242499697392d3ULL, -183}, {0xfd87b5f28300ca0eULL, -157}, {0xbce5086492111aebULL, -130},
+    {0x8cbccc096f5088ccULL, -103}, {0xd1b71758e219652cULL, -77}, {0x9c40000000000000ULL, -50},
+    {0xe8d4a51000000000ULL, -24}, {0xad78ebc5ac620000ULL, 3}, {0x813f3978f8940984ULL, 30},
+    {0xc097ce7bc90715b3ULL, 56}, {0x8f7e32ce7bea5c70ULL, 83}, {0xd5d238a4abe98068ULL, 109},
+    {0x9f4f2726179a2245ULL, 136}, {0xed63a231d4c4fb27ULL, 162}, {0xb0de65388cc8ada8ULL, 189},
+    {0x83c7088e1aab65dbULL, 216}, {0xc45d1df942711d9aULL, 242}, {0x924d692ca61be758ULL, 269},
+    {0xda01ee641a708deaULL, 295}, {0xa26da3999aef774aULL, 322}, {0xf209787bb47d6b85ULL, 348},
+    {0xb454e4a179dd1877ULL, 375}, {0x865b86925b9bc5c2ULL, 402}, {0xc83553c5c8965d3dULL, 428},
+    {0x952ab45cfa97a0b3ULL, 455}, {0xde469fbd99a05fe3ULL, 481}, {0xa59bc234db398c25ULL, 508},
+    {0xf6c69a72a3989f5cULL, 534}, {0xb7dcbf5354e9beceULL, 561}, {0x88fcf317f22241e2ULL, 588},
+    {0xcc20ce9bd35c78a5ULL, 614}, {0x98165af37b2153dfULL, 641}, {0xe2a0b5dc971f303aULL, 667},
+    {0xa8d9d1535ce3b396ULL, 694}, {0xfb9b7cd9a4a7443cULL, 720}, {0xbb764c4ca7a44410ULL, 747},
+    {0x8bab8eefb6409c1aULL, 774}, {0xd01fef10a657842cULL, 800}, {0x9b10a4e5e9913129ULL, 827},
+    {0xe7109bfba19c0c9dULL, 853}, {0xac2820d9623bf429ULL, 880}, {0x80444b5e7aa7cf85ULL, 907},
+    {0xbf21e44003acdd2dULL, 933}, {0x8e679c2f5e44ff8fULL, 960}, {0xd433179d9c8cb841ULL, 986},
+    {0x9e19db92b4e31ba9ULL, 1013}, {0xeb96bf6ebadf77d9ULL, 1039}, {0xaf87023b9bf0ee6bULL, 1066},
+};
+
+template <typename T> struct pow10_u64_t { static const uint64_t table[20]; };
+template <typename T>
+const uint64_t pow10_u64_t<T>::table[20] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL,
+    10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+    1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL};
+
+// moves the last digit towards w as long as the result stays within the rounding interval
+inline void _grisu_round(char *buf, int len, uint64_t delta, uint64_t rest, uint64_t ten_kappa, uint64_t wp_w) {
+  while (rest < wp_w && delta - rest >= ten_kappa && (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+    --buf[len - 1];
+    rest += ten_kappa;
+  }
+}
+
+// stores the digits of a positive finite double to buf (up to 17 chars, not NUL-terminated) and returns their number; the
+// value equals digits * 10^*exp10
+inline int _grisu2(double n, char *buf, int *exp10) {
+  const uint64_t hidden_bit = static_cast<uint64_t>(1) << 52;
+  uint64_t bits;
+  memcpy(&bits, &n, sizeof(bits));
+  int biased_e = static_cast<int>((bits >> 52) & 0x7ff);
+  uint64_t significand = bits & (hidden_bit - 1);
+  diy_fp v = biased_e != 0 ? diy_fp(significand | hidden_bit, biased_e - 1075) : diy_fp(significand, -1074);
+
+  // boundaries of the rounding interval; the lower one is closer when the significand is a power of two
+  diy_fp plus = _diy_fp_normalize(diy_fp((v.f << 1) + 1, v.e - 1));
+  diy_fp minus = significand == 0 && biased_e > 1 ? diy_fp((v.f << 2) - 1, v.e - 2) : diy_fp((v.f << 1) - 1, v.e - 1);
+  minus.f <<= minus.e - plus.e;
+  minus.e = plus.e;
+
+  // scale by a cached power of ten so that the binary exponent of the product falls into [-60, -32]
+  double dk = (-61 - plus.e) * 0.30102999566398114 + 347;
+  int k = static_cast<int>(dk);
+  if (dk - k > 0.0) {
+    ++k;
+  }
+  unsigned index = static_cast<unsigned>((k >> 3) + 1);
+  *exp10 = -(-348 + static_cast<int>(index << 3));
+  diy_fp c(cached_power_t<bool>::table[index].f, cached_power_t<bool>::table[index].e);
+  diy_fp w = _diy_fp_mul(_diy_fp_normalize(v), c), wp = _diy_fp_mul(plus, c), wm = _diy_fp_mul(minus, c);
+  ++wm.f;
+  --wp.f;
+
+  // generate the digits of wp until they are within the (conservatively narrowed) interval
+  uint64_t delta = wp.f - wm.f, wp_w = wp.f - w.f;
+  const diy_fp one(static_cast<uint64_t>(1) << -wp.e, wp.e);
+  uint32_t p1 = static_cast<uint32_t>(wp.f >> -one.e);
+  uint64_t p2 = wp.f & (one.f - 1);
+  int kappa = 1, len = 0;
+  while (kappa < 10 && p1 >= pow10_u64_t<bool>::table[kappa]) {
+    ++kappa;
+  }
+  while (kappa > 0) {
+    uint64_t div = pow10_u64_t<bool>::table[kappa - 1];
+    uint32_t d = static_cast<uint32_t>(p1 / div);
+    p1 = static_cast<uint32_t>(p1 % div);
+    if (d != 0 || len != 0) {
+      buf[len++] = static_cast<char>('0' + d);
+    }
+    --kappa;
+    uint64_t rest = (static_cast<uint64_t>(p1) << -one.e) + p2;
+    if (rest <= delta) {
+      *exp10 += kappa;
+      _grisu_round(buf, len, delta, rest, pow10_u64_t<bool>::table[kappa] << -one.e, wp_w);
+      return len;
+    }
+  }
+  while (1) {
+    p2 *= 10;
+    delta *= 10;
+    char d = static_cast<char>(p2 >> -one.e);
+    if (d != 0 || len != 0) {
+      buf[len++] = static_cast<char>('0' + d);
+    }
+    p2 &= one.f - 1;
+    --kappa;
+    if (p2 < delta) {
+      *exp10 += kappa;
+      _grisu_round(buf, len, delta, p2, one.f, wp_w * (-kappa < 20 ? pow10_u64_t<bool>::table[-kappa] : 0));
+      return len;
+    }
+  }
+}
+
+// unsigned integer of up to 1280 bits, which is enough for the comparisons made by _shorten_digits
+class _bignum {
+  enum { MAX_LIMBS = 40 };
+  uint32_t limbs_[MAX_LIMBS]; // least significant first
+  int size_;
+
+public:
+  explicit _bignum(uint64_t v) : size_(0) {
+    for (; v != 0; v >>= 32) {
+      limbs_[size_++] = static_cast<uint32_t>(v);
+    }
+  }
+  void mul(uint32_t m) {
+    uint64_t carry = 0;
+    for (int i = 0; i != size_; ++i) {
+      uint64_t t = static_cast<uint64_t>(limbs_[i]) * m + carry;
+      limbs_[i] = static_cast<uint32_t>(t);
+      carry = t >> 32;
+    }
+    if (carry != 0) {
+      limbs_[size_++] = static_cast<uint32_t>(carry);
+    }
+  }
+  void mul_pow5(int e) {
+    for (; e >= 13; e -= 13) {
+      mul(1220703125); // 5^13
+    }
+    uint32_t m = 1;
+    for (; e > 0; --e) {
+      m *= 5;
+    }
+    mul(m);
+  }
+  void shift_left(int bits) {
+    int words = bits / 32;
+    bits %= 32;
+    if (bits != 0) {
+      uint32_t carry = 0;
+      for (int i = 0; i != size_; ++i) {
+        uint32_t t = limbs_[i];
+        limbs_[i] = (t << bits) | carry;
+        carry = t >> (32 - bits);
+      }
+      if (carry != 0) {
+        limbs_[size_++] = carry;
+      }
+    }
+    if (words != 0) {
+      memmove(limbs_ + words, limbs_, size_ * sizeof(limbs_[0]));
+      memset(limbs_, 0, words * sizeof(limbs_[0]));
+      size_ += words;
+    }
+  }
+  int compare(const _bignum &x) const {
+    if (size_ != x.size_) {
+      return size_ < x.size_ ? -1 : 1;
+    }
+    for (int i = size_ - 1; i >= 0; --i) {
+      if (limbs_[i] != x.limbs_[i]) {
+        return limbs_[i] < x.limbs_[i] ? -1 : 1;
+      }
+    }
+    return 0;
+  }
+};
+
+// compares digits * 10^exp10 with boundary * 2^exp2 exactly; both digits and boundary must be non-zero
+inline int _compare_decimal_binary(uint64_t digits, int exp10, uint64_t boundary, int exp2) {
+  // 10^exp10 = 5^exp10 * 2^exp10
+  _bignum x(digits), y(boundary);
+  if (exp10 >= 0) {
+    x.mul_pow5(exp10);
+  } else {
+    y.mul_pow5(-exp10);
+  }
+  if (exp2 >= exp10) {
+    y.shift_left(exp2 - exp10);
+  } else {
+    x.shift_left(exp10 - exp2);
+  }
+  return x.compare(y);
+}
+
+// Grisu2 occasionally misses a shorter representation that lies close to the boundary of the rounding interval, e.g. emits
+// 6489999999999999e-19 for 0.000649 or 84290000000000005e-32 for 8.429e-16.  The digits rounded down and up to one place less
+// are tried, and those that collapse to a shorter form are adopted if they are still within the rounding interval of n, which
+// is checked exactly.  The digits of Grisu2 are within the interval, so a candidate rounded down is compared only with the
+// lower boundary, and one rounded up only with the upper boundary.
+inline int _shorten_digits(double n, char *digits, int len, int *exp10) {
+  const uint64_t hidden_bit = static_cast<uint64_t>(1) << 52;
+  uint64_t bits;
+  memcpy(&bits, &n, sizeof(bits));
+  int biased_e = static_cast<int>((bits >> 52) & 0x7ff);
+  uint64_t significand = bits & (hidden_bit - 1);
+  uint64_t f = biased_e != 0 ? significand | hidden_bit : significand;
+  int e = biased_e != 0 ? biased_e - 1075 : -1074;
+  // a decimal on a boundary reads back to the double whose significand is even
+  bool even = (f & 1) == 0;
+  for (int round_up = digits[len - 1] >= '5'; round_up >= 0 && round_up <= 1; round_up += digits[len - 1] >= '5' ? -1 : 1) {
+    char cand[20];
+    int cand_len = len - 1, cand_exp10 = *exp10 + 1;
+    memcpy(cand, digits, cand_len);
+    if (round_up) {
+      int i = cand_len - 1;
+      for (; i >= 0 && cand[i] == '9'; --i) {
+        cand[i] = '0';
+      }
+      if (i < 0) {
+        cand[0] = '1';
+        cand_len = 1;
+        cand_exp10 += len - 1;
+      } else {
+        ++cand[i];
+      }
+    }
+    for (; cand_len > 1 && cand[cand_len - 1] == '0'; --cand_len) {
+      ++cand_exp10;
+    }
+    if (cand_len >= len - 1) {
+      continue;
+    }
+    uint64_t cand_digits = 0;
+    for (int i = 0; i != cand_len; ++i) {
+      cand_digits = cand_digits * 10 + (cand[i] - '0');
+    }
+    int cmp;
+    if (round_up) {
+      cmp = -_compare_decimal_binary(cand_digits, cand_exp10, 2 * f + 1, e - 1);
+    } else if (significand == 0 && biased_e > 1) {
+      // the lower boundary is closer when the significand is a power of two
+      cmp = _compare_decimal_binary(cand_digits, cand_exp10, 4 * f - 1, e - 2);
+    } else {
+      cmp = _compare_decimal_binary(cand_digits, cand_exp10, 2 * f - 1, e - 1);
+    }
+    if (cmp > 0 || (cmp == 0 && even)) {
+      memcpy(digits, cand, cand_len);
+      *exp10 = cand_exp10;
+      return cand_len;
+    }
+  }
+  return len;
+}
+
+// writes a finite double in the shortest form that reads back to the same value, using the notation of printf("%.17g"), and
+// returns the end of the output; buf should be at least 32 bytes long
+inline char *_format_double(char *buf, double n) {
+  char *p = buf;
+  if (n < 0 || (n == 0 && 1 / n < 0)) {
+    *p++ = '-';
+    n = -n;
+  }
+  if (n == 0) {
+    *p++ = '0';
+    return p;
+  }
+  char digits[20];
+  int exp10, len = _grisu2(n, digits, &exp10);
+  if (len >= 16) {
+    len = _shorten_digits(n, digits, len, &exp10);
+  }
+  int point = len + exp10; // position of the decimal point relative to the first digit
+  if (point - 1 < -4 || point - 1 >= 17) {
+    *p++ = digits[0];
+    if (len > 1) {
+      *p++ = '.';
+      memcpy(p, digits + 1, len - 1);
+      p += len - 1;
+    }
+    int e = point - 1;
+    *p++ = 'e';
+    *p++ = e < 0 ? '-' : '+';
+    if (e < 0) {
+      e = -e;
+    }
+    if (e >= 100) {
+      *p++ = static_cast<char>('0' + e / 100);
+      e %= 100;
+    }
+    *p++ = static_cast<char>('0' + e / 10);
+    *p++ = static_cast<char>('0' + e % 10);
+  } else if (point <= 0) {
+    *p++ = '0';
+    *p++ = '.';
+    memset(p, '0', -point);
+    p += -point;
+    memcpy(p, digits, len);
+    p += len;
+  } else if (point < len) {
+    memcpy(p, digits, point);
+    p += point;
+    *p++ = '.';
+    memcpy(p, digits + point, len - point);
+    p += len - point;
+  } else {
+    memcpy(p, digits, len);
+    p += len;
+    memset(p, '0', point - len);
+    p += point - len;
+  }
+  return p;
+}
+
+#ifdef PICOJSON_USE_INT64
+inline char *_format_int64(char *buf, int64_t n) {
+  uint64_t u = static_cast<uint64_t>(n);
+  if (n < 0) {
+    *buf++ = '-';
+    u = 0 - u;
+  }
+  char tmp[20], *t = tmp + sizeof(tmp);
+  do {
+    *--t = static_cast<char>('0' + u % 10);
+    u /= 10;
+  } while (u != 0);
+  size_t len = tmp + sizeof(tmp) - t;
+  memcpy(buf, t, len);
+  return buf + len;
 }
+#endif
 
 inline std::string value::to_str() const {
-  switch (type_) {
+  switch (_type()) {
   case null_type:
     return "null";
   case boolean_type:
-    return u_.boolean_ ? "true" : "false";
+    return get<bool>() ? "true" : "false";
 #ifdef PICOJSON_USE_INT64
   case int64_type: {
     char buf[sizeof("-9223372036854775808")];
-    SNPRINTF(buf, sizeof(buf), "%" PRId64, u_.int64_);
-    return buf;
+    return std::string(buf, _format_int64(buf, _get_int64()));
   }
 #endif
   case number_type: {
-    char buf[256];
-    double tmp;
-    SNPRINTF(buf, sizeof(buf), fabs(u_.number_) < (1ULL << 53) && modf(u_.number_, &tmp) == 0 ? "%.f" : "%.17g", u_.number_);
-#if PICOJSON_USE_LOCALE
-    char *decimal_point = localeconv()->decimal_point;
-    if (strcmp(decimal_point, ".") != 0) {
-      size_t decimal_point_len = strlen(decimal_point);
-      for (char *p = buf; *p != '\0'; ++p) {
-        if (strncmp(p, decimal_point, decimal_point_len) == 0) {
-          return std::string(buf, p) + "." + (p + decimal_point_len);
-        }
-      }
-    }
-#endif
-    return buf;
+    char buf[32];
+    return std::string(buf, _format_double(buf, get<double>()));
   }
   case string_type:
-    return *u_.string_;
+    return get_string_view().str();
   case array_type:
     return "array";
   case object_type:
@@ -522,6 +2155,94 @@ inline std::string value::to_str() const {
   return std::string();
 }
 
+// character classes used by the parser and the serializer, indexed by unsigned char
+template <typename T> struct char_class_t {
+  enum {
+    ws = 1,        // whitespace
+    str_end = 2,   // characters that terminate a run of plain characters within a string: '"', '\\', and control characters
+    structural = 4, // {}[]:,
+    escape = 8      // characters that are escaped when serialized: '"', '\\', '/', control characters, and DEL
+  };
+  static const unsigned char table[256];
+};
+template <typename T>
+const unsigned char char_class_t<T>::table[256] = {
+    10, 10, 10, 10, 10, 10, 10, 10, 10, 11, 11, 10, 10, 11, 10, 10, // 0x00
+    10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, // 0x10
+    1,  0,  10, 0,  0,  0,  0,  0,  0,  0,  0,  0,  4,  0,  0,  8,  // 0x20
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  4,  0,  0,  0,  0,  0,  // 0x30
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  // 0x40
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  4,  10, 4,  0,  0,  // 0x50
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  // 0x60
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  4,  0,  4,  0,  8,  // 0x70
+};
+typedef char_class_t<bool> char_class;
+
+#if PICOJSON_USE_SSE2 || PICOJSON_USE_AVX2
+inline int _ctz(unsigned bits) {
+#ifdef _MSC_VER
+  unsigned long idx;
+  _BitScanForward(&idx, bits);
+  return static_cast<int>(idx);
+#else
+  return __builtin_ctz(bits);
+#endif
+}
+#endif
+
+// returns the first character in [p, end) that has char_class::escape, or end if none
+inline const char *_find_escape(const char *p, const char *end) {
+#if PICOJSON_USE_AVX2
+  const __m256i quote32 = _mm256_set1_epi8('"'), backslash32 = _mm256_set1_epi8('\\'), slash32 = _mm256_set1_epi8('/'),
+                del32 = _mm256_set1_epi8(0x7f), ctrl32 = _mm256_set1_epi8(0x1f);
+  for (; end - p >= 32; p += 32) {
+    __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote32), _mm256_cmpeq_epi8(chunk, backslash32)),
+                                  _mm256_or_si256(_mm256_cmpeq_epi8(chunk, slash32), _mm256_cmpeq_epi8(chunk, del32)));
+    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(_mm256_min_epu8(chunk, ctrl32), chunk));
+    unsigned bits = static_cast<unsigned>(_mm256_movemask_epi8(hit));
+    if (bits != 0) {
+      return p + _ctz(bits);
+    }
+  }
+#endif
+#if PICOJSON_USE_SSE2 || PICOJSON_USE_AVX2
+  const __m128i quote = _mm_set1_epi8('"'), backslash = _mm_set1_epi8('\\'), slash = _mm_set1_epi8('/'), del = _mm_set1_epi8(0x7f),
+                ctrl = _mm_set1_epi8(0x1f);
+  for (; end - p >= 16; p += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+                               _mm_or_si128(_mm_cmpeq_epi8(chunk, slash), _mm_cmpeq_epi8(chunk, del)));
+    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(_mm_min_epu8(chunk, ctrl), chunk));
+    unsigned bits = static_cast<unsigned>(_mm_movemask_epi8(hit));
+    if (bits != 0) {
+      return p + _ctz(bits);
+    }
+  }
+#endif
+  for (; p != end; ++p) {
+    if ((char_class::table[static_cast<unsigned char>(*p)] & char_class::escape) != 0) {
+      break;
+    }
+  }
+  return p;
+}
+
+inline void value::_check_plain() {
+#if !PICOJSON_USE_NAN_BOXING
+  string_view s = get_string_view();
+  plain_ = _find_escape(s.begin(), s.end()) == s.end();
+#endif
+}
+
+inline void value::_set_plain(bool plain) {
+#if !PICOJSON_USE_NAN_BOXING
+  plain_ = plain;
+#else
+  (void)plain;
+#endif
+}
+
 template <typename Iter> void copy(const std::string &s, Iter oi) {
   std::copy(s.begin(), s.end(), oi);
 }
@@ -556,100 +2277,535 @@ template <typename Iter> struct serialize_str_char {
   }
 };
 
-template <typename Iter> void serialize_str(const std::string &s, Iter oi) {
-  *oi++ = '"';
-  serialize_str_char<Iter> process_char = {oi};
-  std::for_each(s.begin(), s.end(), process_char);
-  *oi++ = '"';
-}
+// the serializer writes to a sink, which is any object that has append(const char *, size_t) and push_back(char), e.g.
+// std::string; the adapters below write to an output iterator, to an ostream, or count the characters
+template <typename Iter> class iterator_sink {
+  Iter oi_;
 
-template <typename Iter> void value::serialize(Iter oi, bool prettify) const {
-  return _serialize(oi, prettify ? 0 : -1);
-}
+public:
+  explicit iterator_sink(const Iter &oi) : oi_(oi) {
+  }
+  void append(const char *s, size_t len) {
+    oi_ = std::copy(s, s + len, oi_);
+  }
+  void push_back(char c) {
+    *oi_++ = c;
+  }
+};
 
-inline std::string value::serialize(bool prettify) const {
-  return _serialize(prettify ? 0 : -1);
-}
+class ostream_sink {
+  std::ostream &os_;
+
+public:
+  explicit ostream_sink(std::ostream &os) : os_(os) {
+  }
+  void append(const char *s, size_t len) {
+    os_.write(s, static_cast<std::streamsize>(len));
+  }
+  void push_back(char c) {
+    os_.put(c);
+  }
+};
+
+class size_sink {
+  size_t size_;
 
-template <typename Iter> void value::_indent(Iter oi, int indent) {
-  *oi++ = '\n';
-  for (int i = 0; i < indent * INDENT_WIDTH; ++i) {
-    *oi++ = ' ';
+public:
+  size_sink() : size_(0) {
+  }
+  void append(const char *, size_t len) {
+    size_ += len;
+  }
+  void push_back(char) {
+    ++size_;
+  }
+  size_t size() const {
+    return size_;
   }
+};
+
+// appends the chars of a string in the value being serialized, which stay valid until the sink is flushed, so that a sink may
+// refer to them instead of copying them (see fd_sink); the other chars, such as those formatted on the stack, are appended
+template <typename Sink> void _append_ref(Sink &out, const char *s, size_t len) {
+  out.append(s, len);
 }
 
-template <typename Iter> void value::_serialize(Iter oi, int indent) const {
-  switch (type_) {
-  case string_type:
-    serialize_str(*u_.string_, oi);
-    break;
-  case array_type: {
-    *oi++ = '[';
-    if (indent != -1) {
-      ++indent;
+#if PICOJSON_USE_POSIX
+// writes to a file descriptor through a buffer of buffer_size bytes.  If ref_size is not 0, runs of at least ref_size chars
+// of the strings in a serialized value are not copied into the buffer but passed to writev() by reference, so they must stay
+// valid until flush() returns (call it before the serialized value is modified or destroyed).  Once a write fails, good() returns false and the output is
+// discarded; errno tells the cause.
+class fd_sink {
+  int fd_;
+  std::vector<char> buf_;
+  size_t size_;    // chars used in buf_
+  size_t pending_; // buf_[pending_, size_) is not yet in iov_
+  size_t ref_size_;
+  std::vector<iovec> iov_;
+  bool good_;
+
+public:
+  explicit fd_sink(int fd, size_t buffer_size = 65536, size_t ref_size = 0)
+      : fd_(fd), buf_(buffer_size != 0 ? buffer_size : 1), size_(0), pending_(0), ref_size_(ref_size), iov_(), good_(true) {
+  }
+  ~fd_sink() {
+    flush();
+  }
+  // copies the chars into the buffer
+  void append(const char *s, size_t len) {
+    while (len != 0) {
+      if (size_ == buf_.size()) {
+        flush();
+      }
+      size_t n = std::min(len, buf_.size() - size_);
+      memcpy(&buf_[0] + size_, s, n);
+      size_ += n;
+      s += n;
+      len -= n;
+    }
+  }
+  // like append(), but refers to a run of at least ref_size chars, which must stay valid until flush() returns
+  void append_ref(const char *s, size_t len) {
+    if (ref_size_ == 0 || len < ref_size_) {
+      append(s, len);
+      return;
+    }
+    _add_iov(&buf_[0] + pending_, size_ - pending_);
+    pending_ = size_;
+    _add_iov(s, len);
+    if (iov_.size() >= _iov_max()) {
+      flush();
     }
-    for (array::const_iterator i = u_.array_->begin(); i != u_.array_->end(); ++i) {
-      if (i != u_.array_->begin()) {
-        *oi++ = ',';
+  }
+  void push_back(char c) {
+    if (size_ == buf_.size()) {
+      flush();
+    }
+    buf_[size_++] = c;
+  }
+  // writes everything appended so far; returns good()
+  bool flush() {
+    _add_iov(&buf_[0] + pending_, size_ - pending_);
+    iovec *iov = iov_.empty() ? NULL : &iov_[0];
+    size_t cnt = iov_.size();
+    while (good_ && cnt != 0) {
+      ssize_t r = writev(fd_, iov, static_cast<int>(std::min(cnt, _iov_max())));
+      if (r < 0) {
+        if (errno != EINTR) {
+          good_ = false;
+        }
+        continue;
       }
-      if (indent != -1) {
-        _indent(oi, indent);
+      // skip what was written, which may end in the middle of an element
+      size_t w = static_cast<size_t>(r);
+      for (; cnt != 0 && w >= iov->iov_len; ++iov, --cnt) {
+        w -= iov->iov_len;
       }
-      i->_serialize(oi, indent);
-    }
-    if (indent != -1) {
-      --indent;
-      if (!u_.array_->empty()) {
-        _indent(oi, indent);
+      if (w != 0) {
+        iov->iov_base = static_cast<char *>(iov->iov_base) + w;
+        iov->iov_len -= w;
       }
     }
-    *oi++ = ']';
-    break;
+    iov_.clear();
+    size_ = pending_ = 0;
+    return good_;
   }
-  case object_type: {
-    *oi++ = '{';
+  bool good() const {
+    return good_;
+  }
+
+private:
+  static size_t _iov_max() {
+#ifdef IOV_MAX
+    return IOV_MAX;
+#else
+    return 1024;
+#endif
+  }
+  void _add_iov(const char *s, size_t len) {
+    if (len != 0) {
+      iovec v;
+      v.iov_base = const_cast<char *>(s);
+      v.iov_len = len;
+      iov_.push_back(v);
+    }
+  }
+  fd_sink(const fd_sink &);
+  fd_sink &operator=(const fd_sink &);
+};
+
+inline void _append_ref(fd_sink &out, const char *s, size_t len) {
+  out.append_ref(s, len);
+}
+#endif
+
+// writes the escape sequence of a character that has char_class::escape to buf, and returns its length
+inline size_t _escape(unsigned char c, char *buf) {
+  static const char hex[] = "0123456789abcdef";
+  buf[0] = '\\';
+  switch (c) {
+  case '"':
+  case '\\':
+  case '/':
+    buf[1] = static_cast<char>(c);
+    return 2;
+  case '\b':
+    buf[1] = 'b';
+    return 2;
+  case '\f':
+    buf[1] = 'f';
+    return 2;
+  case '\n':
+    buf[1] = 'n';
+    return 2;
+  case '\r':
+    buf[1] = 'r';
+    return 2;
+  case '\t':
+    buf[1] = 't';
+    return 2;
+  default:
+    buf[1] = 'u';
+    buf[2] = buf[3] = '0';
+    buf[4] = hex[c >> 4];
+    buf[5] = hex[c & 15];
+    return 6;
+  }
+}
+
+// if `ref` is true, the chars stay valid until the sink is flushed (see _append_ref)
+template <typename Sink> void _serialize_str(Sink &out, const char *first, const char *last, bool ref = false) {
+  out.push_back('"');
+  for (const char *p; (p = _find_escape(first, last)) != last; first = p + 1) {
+    if (ref) {
+      _append_ref(out, first, static_cast<size_t>(p - first));
+    } else {
+      out.append(first, static_cast<size_t>(p - first));
+    }
+    char buf[6];
+    out.append(buf, _escape(static_cast<unsigned char>(*p), buf));
+  }
+  if (ref) {
+    _append_ref(out, first, static_cast<size_t>(last - first));
+  } else {
+    out.append(first, static_cast<size_t>(last - first));
+  }
+  out.push_back('"');
+}
+
+template <typename Iter> void _serialize_str(const char *first, const char *last, Iter oi) {
+  iterator_sink<Iter> out(oi);
+  _serialize_str(out, first, last);
+}
+
+template <typename Iter> void serialize_str(const std::string &s, Iter oi) {
+  _serialize_str(s.data(), s.data() + s.size(), oi);
+}
+
+template <typename Iter> void value::serialize(Iter oi, bool prettify) const {
+  iterator_sink<Iter> out(oi);
+  _serialize(out, prettify ? 0 : -1);
+}
+
+inline std::string value::serialize(bool prettify) const {
+  return _serialize(prettify ? 0 : -1);
+}
+
+template <typename Sink> void value::serialize_to(Sink &out, bool prettify) const {
+  _serialize(out, prettify ? 0 : -1);
+}
+
+inline size_t value::serialized_size(bool prettify) const {
+  size_sink out;
+  _serialize(out, prettify ? 0 : -1);
+  return out.size();
+}
+
+template <typename Sink> void value::_indent(Sink &out, int indent) {
+  static const char spaces[] = "                                ";
+  out.push_back('\n');
+  for (int n = indent * INDENT_WIDTH; n > 0; n -= static_cast<int>(sizeof(spaces) - 1)) {
+    out.append(spaces, n < static_cast<int>(sizeof(spaces) - 1) ? static_cast<size_t>(n) : sizeof(spaces) - 1);
+  }
+}
+
+template <typename Sink> void value::_serialize(Sink &out, int indent) const {
+  switch (_type()) {
+  case null_type:
+    out.append("null", 4);
+    break;
+  case boolean_type:
+    if (get<bool>()) {
+      out.append("true", 4);
+    } else {
+      out.append("false", 5);
+    }
+    break;
+  case string_type: {
+    string_view s = get_string_view();
+    if (_plain()) {
+      out.push_back('"');
+      _append_ref(out, s.data(), s.size());
+      out.push_back('"');
+    } else {
+      _serialize_str(out, s.begin(), s.end(), true);
+    }
+    break;
+  }
+  case array_type: {
+    const array &a = get<array>();
+    out.push_back('[');
     if (indent != -1) {
       ++indent;
     }
-    for (object::const_iterator i = u_.object_->begin(); i != u_.object_->end(); ++i) {
-      if (i != u_.object_->begin()) {
-        *oi++ = ',';
-      }
-      if (indent != -1) {
-        _indent(oi, indent);
-      }
-      serialize_str(i->first, oi);
-      *oi++ = ':';
-      if (indent != -1) {
-        *oi++ = ' ';
+    _serialize_items(out, a.begin(), a.end(), false, indent);
+    if (indent != -1) {
+      --indent;
+      if (!a.empty()) {
+        _indent(out, indent);
       }
-      i->second._serialize(oi, indent);
     }
+    out.push_back(']');
+    break;
+  }
+  case object_type: {
+    const object &o = get<object>();
+    out.push_back('{');
+    if (indent != -1) {
+      ++indent;
+    }
+    _serialize_members(out, o.begin(), o.end(), false, indent);
     if (indent != -1) {
       --indent;
-      if (!u_.object_->empty()) {
-        _indent(oi, indent);
+      if (!o.empty()) {
+        _indent(out, indent);
       }
     }
-    *oi++ = '}';
+    out.push_back('}');
     break;
   }
-  default:
-    copy(to_str(), oi);
+#ifdef PICOJSON_USE_INT64
+  case int64_type: {
+    char buf[sizeof("-9223372036854775808")];
+    out.append(buf, static_cast<size_t>(_format_int64(buf, _get_int64()) - buf));
+    break;
+  }
+#endif
+  case number_type: {
+    char buf[32];
+    out.append(buf, static_cast<size_t>(_format_double(buf, get<double>()) - buf));
     break;
   }
+  default:
+    PICOJSON_ASSERT(0);
+#ifdef _MSC_VER
+    __assume(0);
+#endif
+  }
   if (indent == 0) {
-    *oi++ = '\n';
+    out.push_back('\n');
   }
 }
 
 inline std::string value::_serialize(int indent) const {
   std::string s;
-  _serialize(std::back_inserter(s), indent);
+  _serialize(s, indent);
   return s;
 }
 
-template <typename Iter> class input {
+// serializes the elements in [first, last), each preceded by a comma unless it is the first one and `comma` is false
+template <typename Sink>
+void value::_serialize_items(Sink &out, array::const_iterator first, array::const_iterator last, bool comma, int indent) {
+  for (array::const_iterator i = first; i != last; ++i) {
+    if (comma || i != first) {
+      out.push_back(',');
+    }
+    if (indent != -1) {
+      _indent(out, indent);
+    }
+    i->_serialize(out, indent);
+  }
+}
+
+template <typename Sink>
+void value::_serialize_members(Sink &out, object::const_iterator first, object::const_iterator last, bool comma, int indent) {
+  for (object::const_iterator i = first; i != last; ++i) {
+    if (comma || i != first) {
+      out.push_back(',');
+    }
+    if (indent != -1) {
+      _indent(out, indent);
+    }
+    _serialize_str(out, i->first.data(), i->first.data() + i->first.size(), true);
+    out.push_back(':');
+    if (indent != -1) {
+      out.push_back(' ');
+    }
+    i->second._serialize(out, indent);
+  }
+}
+
+// writes JSON to a sink as the calls are made, without building a value; the nesting of the calls is checked unless NDEBUG
+// is defined
+template <typename Sink> class writer {
+  Sink &out_;
+  bool prettify_;
+  int depth_;
+  enum { _first, _next, _after_key } state_;
+#ifndef NDEBUG
+  std::vector<char> stack_; // '[' or '{' for each open container
+#endif
+
+public:
+  explicit writer(Sink &out, bool prettify = false) : out_(out), prettify_(prettify), depth_(0), state_(_first) {
+  }
+  void begin_array() {
+    _begin_value();
+    out_.push_back('[');
+    _open('[');
+  }
+  void end_array() {
+    _close('[');
+    out_.push_back(']');
+    _end_value();
+  }
+  void begin_object() {
+    _begin_value();
+    out_.push_back('{');
+    _open('{');
+  }
+  void end_object() {
+    _close('{');
+    out_.push_back('}');
+    _end_value();
+  }
+  void key(const string_view &k) {
+#ifndef NDEBUG
+    PICOJSON_ASSERT("key() outside of an object" && !stack_.empty() && stack_.back() == '{' && state_ != _after_key);
+#endif
+    if (state_ == _next) {
+      out_.push_back(',');
+    }
+    if (prettify_) {
+      picojson::value::_indent(out_, depth_);
+    }
+    _serialize_str(out_, k.begin(), k.end());
+    out_.push_back(':');
+    if (prettify_) {
+      out_.push_back(' ');
+    }
+    state_ = _after_key;
+  }
+  void value(const null &) {
+    _begin_value();
+    out_.append("null", 4);
+    _end_value();
+  }
+  void value(bool b) {
+    _begin_value();
+    if (b) {
+      out_.append("true", 4);
+    } else {
+      out_.append("false", 5);
+    }
+    _end_value();
+  }
+#ifdef PICOJSON_USE_INT64
+  void value(int64_t i) {
+    _begin_value();
+    char buf[sizeof("-9223372036854775808")];
+    out_.append(buf, static_cast<size_t>(_format_int64(buf, i) - buf));
+    _end_value();
+  }
+#endif
+  void value(double n) {
+    _check_finite(n);
+    _begin_value();
+    char buf[32];
+    out_.append(buf, static_cast<size_t>(_format_double(buf, n) - buf));
+    _end_value();
+  }
+  void value(const string_view &s) {
+    _begin_value();
+    _serialize_str(out_, s.begin(), s.end());
+    _end_value();
+  }
+  void value(const std::string &s) {
+    value(string_view(s));
+  }
+  void value(const char *s) {
+    value(string_view(s));
+  }
+  // writes a value tree in place of a single value
+  void value(const picojson::value &v) {
+    _begin_value();
+    v._serialize(out_, prettify_ ? depth_ : -1); // which ends a prettified document with a newline by itself
+    state_ = _next;
+  }
+
+private:
+  template <typename T> void value(const T *); // intentionally defined to block implicit conversion of pointer to bool
+  void _begin_value() {
+#ifndef NDEBUG
+    PICOJSON_ASSERT("value written after the end of the document" && (depth_ != 0 || state_ == _first));
+    PICOJSON_ASSERT("value in an object without a key" && (stack_.empty() || stack_.back() == '[' || state_ == _after_key));
+#endif
+    if (state_ == _after_key) {
+      return;
+    }
+    if (state_ == _next) {
+      out_.push_back(',');
+    }
+    if (prettify_ && depth_ != 0) {
+      picojson::value::_indent(out_, depth_);
+    }
+  }
+  void _end_value() {
+    state_ = _next;
+    if (prettify_ && depth_ == 0) {
+      out_.push_back('\n');
+    }
+  }
+  void _open(char type) {
+#ifndef NDEBUG
+    stack_.push_back(type);
+#else
+    (void)type;
+#endif
+    ++depth_;
+    state_ = _first;
+  }
+  void _close(char type) {
+#ifndef NDEBUG
+    PICOJSON_ASSERT("mismatched end of a container" && !stack_.empty() && stack_.back() == type && state_ != _after_key);
+    stack_.pop_back();
+#else
+    (void)type;
+#endif
+    --depth_;
+    if (prettify_ && state_ == _next) {
+      picojson::value::_indent(out_, depth_);
+    }
+  }
+};
+
+// the iterators over contiguous chars, which are parsed by contiguous_input; the overloads are only declared, so where the
+// iterators of std::string or std::vector<char> are plain pointers, they merely declare the same function again
+struct _contiguous_yes {
+  char c[2];
+};
+_contiguous_yes _contiguous(const char *const *);
+_contiguous_yes _contiguous(char *const *);
+_contiguous_yes _contiguous(const std::string::const_iterator *);
+_contiguous_yes _contiguous(const std::string::iterator *);
+_contiguous_yes _contiguous(const std::vector<char>::const_iterator *);
+_contiguous_yes _contiguous(const std::vector<char>::iterator *);
+char _contiguous(...);
+template <typename Iter> struct _is_contiguous {
+  enum { value = sizeof(_contiguous(static_cast<const Iter *>(NULL))) == sizeof(_contiguous_yes) };
+};
+
+template <typename Iter, bool Contiguous = _is_contiguous<Iter>::value> class input {
 protected:
   Iter cur_, end_;
   bool consumed_;
@@ -677,7 +2833,7 @@ public:
   }
   Iter cur() const {
     if (consumed_) {
-      input<Iter> *self = const_cast<input<Iter> *>(this);
+      input *self = const_cast<input *>(this);
       self->consumed_ = false;
       ++self->cur_;
     }
@@ -695,6 +2851,14 @@ public:
       }
     }
   }
+  template <typename String> void copy_str_run(String &) {
+  }
+  bool plain_str(const char *&, const char *&, bool * = NULL) {
+    return false;
+  }
+  bool raw_container(const char *&, const char *&, size_t) {
+    return false;
+  }
   bool expect(const int expected) {
     skip_ws();
     if (getc() != expected) {
@@ -714,83 +2878,482 @@ public:
   }
 };
 
-template <typename Iter> inline int _parse_quadhex(input<Iter> &in) {
-  int uni_ch = 0, hex;
-  for (int i = 0; i < 4; i++) {
-    if ((hex = in.getc()) == -1) {
-      return -1;
+// returns the first character in [p, end) that has char_class::str_end, or end if none; if `plain` is not NULL, also sets it to
+// whether none of the characters before that one has char_class::escape (that is, is '/' or DEL), so that a string is not
+// scanned again to find out if it has to be escaped when serialized
+inline const char *_find_str_end(const char *p, const char *end, bool *plain = NULL) {
+#if PICOJSON_USE_AVX2
+  const __m256i quote32 = _mm256_set1_epi8('"'), backslash32 = _mm256_set1_epi8('\\'), ctrl32 = _mm256_set1_epi8(0x1f),
+                slash32 = _mm256_set1_epi8('/'), del32 = _mm256_set1_epi8(0x7f);
+  __m256i escapes32 = _mm256_setzero_si256();
+  for (; end - p >= 32; p += 32) {
+    __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote32), _mm256_cmpeq_epi8(chunk, backslash32)),
+                                  _mm256_cmpeq_epi8(_mm256_min_epu8(chunk, ctrl32), chunk));
+    __m256i escape = plain != NULL ? _mm256_or_si256(_mm256_cmpeq_epi8(chunk, slash32), _mm256_cmpeq_epi8(chunk, del32))
+                                   : _mm256_setzero_si256();
+    unsigned bits = static_cast<unsigned>(_mm256_movemask_epi8(hit));
+    if (bits != 0) {
+      if (plain != NULL) {
+        unsigned before = (1u << _ctz(bits)) - 1;
+        *plain = _mm256_movemask_epi8(escapes32) == 0 && (static_cast<unsigned>(_mm256_movemask_epi8(escape)) & before) == 0;
+      }
+      return p + _ctz(bits);
     }
-    if ('0' <= hex && hex <= '9') {
-      hex -= '0';
-    } else if ('A' <= hex && hex <= 'F') {
-      hex -= 'A' - 0xa;
-    } else if ('a' <= hex && hex <= 'f') {
-      hex -= 'a' - 0xa;
-    } else {
-      in.ungetc();
-      return -1;
+    escapes32 = _mm256_or_si256(escapes32, escape);
+  }
+  if (plain != NULL && _mm256_movemask_epi8(escapes32) != 0) {
+    // the rest is searched only for the end
+    *plain = false;
+    return _find_str_end(p, end);
+  }
+#endif
+#if PICOJSON_USE_SSE2 || PICOJSON_USE_AVX2
+  const __m128i quote = _mm_set1_epi8('"'), backslash = _mm_set1_epi8('\\'), ctrl = _mm_set1_epi8(0x1f),
+                slash = _mm_set1_epi8('/'), del = _mm_set1_epi8(0x7f);
+  __m128i escapes = _mm_setzero_si128();
+  for (; end - p >= 16; p += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+                               _mm_cmpeq_epi8(_mm_min_epu8(chunk, ctrl), chunk));
+    __m128i escape = plain != NULL ? _mm_or_si128(_mm_cmpeq_epi8(chunk, slash), _mm_cmpeq_epi8(chunk, del)) : _mm_setzero_si128();
+    unsigned bits = static_cast<unsigned>(_mm_movemask_epi8(hit));
+    if (bits != 0) {
+      if (plain != NULL) {
+        unsigned before = (1u << _ctz(bits)) - 1;
+        *plain = _mm_movemask_epi8(escapes) == 0 && (static_cast<unsigned>(_mm_movemask_epi8(escape)) & before) == 0;
+      }
+      return p + _ctz(bits);
     }
-    uni_ch = uni_ch * 16 + hex;
+    escapes = _mm_or_si128(escapes, escape);
   }
-  return uni_ch;
+  if (plain != NULL && _mm_movemask_epi8(escapes) != 0) {
+    *plain = false;
+    return _find_str_end(p, end);
+  }
+#endif
+  unsigned seen = 0;
+  for (; p != end; ++p) {
+    unsigned cls = char_class::table[static_cast<unsigned char>(*p)];
+    if ((cls & char_class::str_end) != 0) {
+      break;
+    }
+    seen |= cls;
+  }
+  if (plain != NULL) {
+    *plain = (seen & char_class::escape) == 0;
+  }
+  return p;
 }
 
-template <typename String, typename Iter> inline bool _parse_codepoint(String &out, input<Iter> &in) {
-  int uni_ch;
-  if ((uni_ch = _parse_quadhex(in)) == -1) {
-    return false;
+// returns the first non-whitespace character in [p, end), or end if none
+inline const char *_skip_ws(const char *p, const char *end) {
+  // fast path for minified input and for the single space after ':' or ','
+  if (p == end || (char_class::table[static_cast<unsigned char>(*p)] & char_class::ws) == 0) {
+    return p;
   }
-  if (0xd800 <= uni_ch && uni_ch <= 0xdfff) {
-    if (0xdc00 <= uni_ch) {
-      // a second 16-bit of a surrogate pair appeared
-      return false;
+  if (++p == end || (char_class::table[static_cast<unsigned char>(*p)] & char_class::ws) == 0) {
+    return p;
+  }
+#if PICOJSON_USE_AVX2
+  const __m256i space32 = _mm256_set1_epi8(' '), tab32 = _mm256_set1_epi8('\t'), lf32 = _mm256_set1_epi8('\n'),
+                cr32 = _mm256_set1_epi8('\r');
+  for (; end - p >= 32; p += 32) {
+    __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i ws = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, space32), _mm256_cmpeq_epi8(chunk, tab32)),
+                                 _mm256_or_si256(_mm256_cmpeq_epi8(chunk, lf32), _mm256_cmpeq_epi8(chunk, cr32)));
+    unsigned bits = ~static_cast<unsigned>(_mm256_movemask_epi8(ws));
+    if (bits != 0) {
+      return p + _ctz(bits);
     }
-    // first 16-bit of surrogate pair, get the next one
-    if (in.getc() != '\\' || in.getc() != 'u') {
-      in.ungetc();
-      return false;
+  }
+#endif
+#if PICOJSON_USE_SSE2 || PICOJSON_USE_AVX2
+  const __m128i space = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t'), lf = _mm_set1_epi8('\n'), cr = _mm_set1_epi8('\r');
+  for (; end - p >= 16; p += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, tab)),
+                              _mm_or_si128(_mm_cmpeq_epi8(chunk, lf), _mm_cmpeq_epi8(chunk, cr)));
+    unsigned bits = ~static_cast<unsigned>(_mm_movemask_epi8(ws)) & 0xffff;
+    if (bits != 0) {
+      return p + _ctz(bits);
     }
-    int second = _parse_quadhex(in);
-    if (!(0xdc00 <= second && second <= 0xdfff)) {
-      return false;
+  }
+#endif
+  for (; p != end; ++p) {
+    if ((char_class::table[static_cast<unsigned char>(*p)] & char_class::ws) == 0) {
+      break;
     }
-    uni_ch = ((uni_ch - 0xd800) << 10) | ((second - 0xdc00) & 0x3ff);
-    uni_ch += 0x10000;
   }
-  if (uni_ch < 0x80) {
-    out.push_back(static_cast<char>(uni_ch));
-  } else {
-    if (uni_ch < 0x800) {
-      out.push_back(static_cast<char>(0xc0 | (uni_ch >> 6)));
-    } else {
-      if (uni_ch < 0x10000) {
-        out.push_back(static_cast<char>(0xe0 | (uni_ch >> 12)));
-      } else {
-        out.push_back(static_cast<char>(0xf0 | (uni_ch >> 18)));
-        out.push_back(static_cast<char>(0x80 | ((uni_ch >> 12) & 0x3f)));
-      }
-      out.push_back(static_cast<char>(0x80 | ((uni_ch >> 6) & 0x3f)));
+  return p;
+}
+
+inline int _ctz64(uint64_t bits) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+  unsigned long idx;
+  _BitScanForward64(&idx, bits);
+  return static_cast<int>(idx);
+#elif defined(_MSC_VER)
+  unsigned long idx;
+  if (_BitScanForward(&idx, static_cast<unsigned long>(bits)))
+    return static_cast<int>(idx);
+  _BitScanForward(&idx, static_cast<unsigned long>(bits >> 32));
+  return 32 + static_cast<int>(idx);
+#else
+  return __builtin_ctzll(bits);
+#endif
+}
+
+// bit i of each mask is set if p[i] is of the class
+struct _block_masks {
+  uint64_t quote, backslash, ws, structural;
+};
+
+// classifies 64 chars
+inline void _classify_block(const char *p, _block_masks &m) {
+#if PICOJSON_USE_SSE2 || PICOJSON_USE_AVX2
+  // '[' | 0x20 == '{' and ']' | 0x20 == '}'
+  const __m128i quote = _mm_set1_epi8('"'), backslash = _mm_set1_epi8('\\'), space = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t'),
+                lf = _mm_set1_epi8('\n'), cr = _mm_set1_epi8('\r'), lower = _mm_set1_epi8(0x20), open = _mm_set1_epi8('{'),
+                close = _mm_set1_epi8('}'), colon = _mm_set1_epi8(':'), comma = _mm_set1_epi8(',');
+  m.quote = m.backslash = m.ws = m.structural = 0;
+  for (int i = 0; i < 64; i += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i)), folded = _mm_or_si128(chunk, lower);
+    __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, tab)),
+                              _mm_or_si128(_mm_cmpeq_epi8(chunk, lf), _mm_cmpeq_epi8(chunk, cr)));
+    __m128i structural = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(folded, open), _mm_cmpeq_epi8(folded, close)),
+                                      _mm_or_si128(_mm_cmpeq_epi8(chunk, colon), _mm_cmpeq_epi8(chunk, comma)));
+    m.quote |= static_cast<uint64_t>(static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, quote)))) << i;
+    m.backslash |= static_cast<uint64_t>(static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, backslash)))) << i;
+    m.ws |= static_cast<uint64_t>(static_cast<unsigned>(_mm_movemask_epi8(ws))) << i;
+    m.structural |= static_cast<uint64_t>(static_cast<unsigned>(_mm_movemask_epi8(structural))) << i;
+  }
+#else
+  m.quote = m.backslash = m.ws = m.structural = 0;
+  for (int i = 0; i < 64; ++i) {
+    uint64_t bit = static_cast<uint64_t>(1) << i;
+    unsigned char cls = char_class::table[static_cast<unsigned char>(p[i])];
+    if ((cls & char_class::ws) != 0) {
+      m.ws |= bit;
+    } else if ((cls & char_class::structural) != 0) {
+      m.structural |= bit;
+    } else if (p[i] == '"') {
+      m.quote |= bit;
+    } else if (p[i] == '\\') {
+      m.backslash |= bit;
     }
-    out.push_back(static_cast<char>(0x80 | (uni_ch & 0x3f)));
   }
-  return true;
+#endif
 }
 
-template <typename String, typename Iter> inline bool _parse_string(String &out, input<Iter> &in) {
+// bit i of the result is the xor of bits 0..i of x
+inline uint64_t _prefix_xor(uint64_t x) {
+  x ^= x << 1;
+  x ^= x << 2;
+  x ^= x << 4;
+  x ^= x << 8;
+  x ^= x << 16;
+  x ^= x << 32;
+  return x;
+}
+
+// stage one of parsing into a tape: stores in out[0..count) the offsets of the structural characters outside of strings,
+// of the opening quotes of strings, and of the first characters of other scalars, and returns count
+inline size_t _index_structurals(const char *first, size_t len, std::vector<uint32_t> &out) {
+  const uint64_t even_bits = 0x5555555555555555ULL;
+  uint64_t prev_escaped = 0, prev_in_string = 0, prev_scalar = 0;
+  size_t count = 0;
+  char tail[64];
+  for (size_t off = 0; off < len; off += 64) {
+    const char *p = first + off;
+    if (len - off < 64) {
+      memset(tail, ' ', sizeof(tail));
+      memcpy(tail, p, len - off);
+      p = tail;
+    }
+    _block_masks m;
+    _classify_block(p, m);
+    // chars preceded by an odd number of backslashes are escaped; a run of backslashes may continue from the previous block
+    uint64_t backslash = m.backslash & ~prev_escaped;
+    uint64_t follows_escape = (backslash << 1) | prev_escaped;
+    uint64_t odd_starts = backslash & ~even_bits & ~follows_escape;
+    uint64_t even_starts = odd_starts + backslash;
+    prev_escaped = even_starts < backslash ? 1 : 0;
+    uint64_t escaped = (even_bits ^ (even_starts << 1)) & follows_escape;
+    // strings span from the opening quote up to (but not including) the closing quote
+    uint64_t quote = m.quote & ~escaped;
+    uint64_t in_string = _prefix_xor(quote) ^ prev_in_string;
+    prev_in_string = 0 - (in_string >> 63);
+    uint64_t scalar = ~(m.quote | m.ws | m.structural) & ~in_string;
+    uint64_t scalar_starts = scalar & ~((scalar << 1) | prev_scalar);
+    prev_scalar = scalar >> 63;
+    uint64_t bits = ((m.structural | scalar_starts) & ~in_string) | (quote & in_string);
+    if (out.size() < count + 64) {
+      out.resize(std::max(out.size() * 2, count + 64));
+    }
+    for (; bits != 0; bits &= bits - 1) {
+      out[count++] = static_cast<uint32_t>(off + _ctz64(bits));
+    }
+  }
+  return count;
+}
+
+// returns the first bracket or quote in [p, end), or end if none
+inline const char *_find_bracket_or_quote(const char *p, const char *end) {
+#if PICOJSON_USE_SSE2 || PICOJSON_USE_AVX2
+  // '[' | 0x20 == '{' and ']' | 0x20 == '}'
+  const __m128i lower = _mm_set1_epi8(0x20), open = _mm_set1_epi8('{'), close = _mm_set1_epi8('}'), quote = _mm_set1_epi8('"');
+  for (; end - p >= 16; p += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)), folded = _mm_or_si128(chunk, lower);
+    __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(folded, open), _mm_cmpeq_epi8(folded, close)), _mm_cmpeq_epi8(chunk, quote));
+    unsigned bits = static_cast<unsigned>(_mm_movemask_epi8(hit));
+    if (bits != 0) {
+      return p + _ctz(bits);
+    }
+  }
+#endif
+  for (; p != end; ++p) {
+    if (*p == '"' || (*p | 0x20) == '{' || (*p | 0x20) == '}') {
+      break;
+    }
+  }
+  return p;
+}
+
+// given the position next to the opening quote of a string, returns the position next to the closing quote, or NULL if the
+// input ends first; the contents are not validated
+inline const char *_skip_str(const char *p, const char *end) {
   while (1) {
-    int ch = in.getc();
-    if (ch < ' ') {
-      in.ungetc();
-      return false;
-    } else if (ch == '"') {
-      return true;
-    } else if (ch == '\\') {
-      if ((ch = in.getc()) == -1) {
-        return false;
+    p = _find_str_end(p, end);
+    if (p == end) {
+      return NULL;
+    } else if (*p == '"') {
+      return p + 1;
+    } else if (*p == '\\' && end - p >= 2) {
+      p += 2;
+    } else {
+      ++p;
+    }
+  }
+}
+
+// given the opening bracket of an array or an object, returns the position next to the matching bracket, or NULL if the
+// input ends first or if more than max_depth arrays and objects are nested (the outermost included); the contents are not
+// validated, except that brackets within strings are ignored
+inline const char *_skip_container(const char *p, const char *end, size_t max_depth = static_cast<size_t>(-1)) {
+  size_t depth = 0;
+  while ((p = _find_bracket_or_quote(p, end)) != end) {
+    switch (*p++) {
+    case '"':
+      if ((p = _skip_str(p, end)) == NULL) {
+        return NULL;
       }
-      switch (ch) {
-#define MAP(sym, val)                                                                                                              \
-  case sym:                                                                                                                        \
+      break;
+    case '[':
+    case '{':
+      if (++depth > max_depth) {
+        return NULL;
+      }
+      break;
+    default:
+      if (--depth == 0) {
+        return p;
+      }
+      break;
+    }
+  }
+  return NULL;
+}
+
+template <typename String> inline void _append(String &out, const char *first, const char *last) {
+  for (; first != last; ++first) {
+    out.push_back(*first);
+  }
+}
+
+inline void _append(std::string &out, const char *first, const char *last) {
+  out.append(first, last);
+}
+
+// called with the first run of a string [first, run_end) and the end of the input; reserves the space for the decoded string if
+// it has escapes, which is never longer than its chars up to the closing quote
+template <typename String> inline void _reserve_str(String &, const char *, const char *, const char *) {
+}
+
+inline void _reserve_str(std::string &out, const char *first, const char *run_end, const char *end) {
+  if (out.empty() && run_end != end && *run_end == '\\') {
+    const char *str_end = _skip_str(run_end, end);
+    out.reserve(static_cast<size_t>((str_end != NULL ? str_end : end) - first));
+  }
+}
+
+// input engine for iterators over contiguous memory; works directly on pointers, and the line number is calculated only when
+// requested (i.e. when reporting an error)
+template <typename Iter> class contiguous_input {
+protected:
+  Iter first_;
+  const char *begin_, *prev_, *cur_, *end_;
+
+public:
+  contiguous_input(const Iter &first, const Iter &last)
+      : first_(first), begin_(first != last ? &*first : ""), prev_(begin_), cur_(begin_), end_(begin_ + (last - first)) {
+  }
+  int getc() {
+    prev_ = cur_;
+    if (cur_ == end_) {
+      return -1;
+    }
+    return *cur_++ & 0xff;
+  }
+  void ungetc() {
+    cur_ = prev_;
+  }
+  Iter cur() const {
+    const_cast<contiguous_input<Iter> *>(this)->prev_ = cur_;
+    return first_ + (cur_ - begin_);
+  }
+  int line() const {
+    return 1 + static_cast<int>(std::count(begin_, prev_, '\n'));
+  }
+  void skip_ws() {
+    prev_ = cur_ = _skip_ws(cur_, end_);
+  }
+  bool expect(const int expected) {
+    skip_ws();
+    if (cur_ == end_ || (*cur_ & 0xff) != expected) {
+      return false;
+    }
+    ++cur_;
+    return true;
+  }
+  template <typename String> void copy_str_run(String &out) {
+    const char *run_end = _find_str_end(cur_, end_);
+    _reserve_str(out, cur_, run_end, end_);
+    _append(out, cur_, run_end);
+    prev_ = cur_ = run_end;
+  }
+  // if the rest of the string contains no escapes, returns its chars and consumes the closing quote; see _find_str_end for
+  // `plain`
+  bool plain_str(const char *&first, const char *&last, bool *plain = NULL) {
+    const char *run_end = _find_str_end(cur_, end_, plain);
+    if (run_end == end_ || *run_end != '"') {
+      return false;
+    }
+    first = cur_;
+    last = run_end;
+    prev_ = run_end;
+    cur_ = run_end + 1;
+    return true;
+  }
+  // if the next value is an array or an object whose brackets are balanced and nested at most max_depth deep, skips it and
+  // returns its chars (which are not validated otherwise)
+  bool raw_container(const char *&first, const char *&last, size_t max_depth) {
+    skip_ws();
+    if (cur_ == end_ || (*cur_ != '[' && *cur_ != '{') || (last = _skip_container(cur_, end_, max_depth)) == NULL) {
+      return false;
+    }
+    first = cur_;
+    prev_ = cur_ = last;
+    return true;
+  }
+  bool match(const char *pattern) {
+    for (; *pattern != '\0'; ++pattern) {
+      if (getc() != (*pattern & 0xff)) {
+        ungetc();
+        return false;
+      }
+    }
+    return true;
+  }
+  bool match(const std::string &pattern) {
+    return match(pattern.c_str());
+  }
+};
+
+template <typename Iter> class input<Iter, true> : public contiguous_input<Iter> {
+public:
+  input(const Iter &first, const Iter &last) : contiguous_input<Iter>(first, last) {
+  }
+};
+
+template <typename Iter> inline int _parse_quadhex(input<Iter> &in) {
+  int uni_ch = 0, hex;
+  for (int i = 0; i < 4; i++) {
+    if ((hex = in.getc()) == -1) {
+      return -1;
+    }
+    if ('0' <= hex && hex <= '9') {
+      hex -= '0';
+    } else if ('A' <= hex && hex <= 'F') {
+      hex -= 'A' - 0xa;
+    } else if ('a' <= hex && hex <= 'f') {
+      hex -= 'a' - 0xa;
+    } else {
+      in.ungetc();
+      return -1;
+    }
+    uni_ch = uni_ch * 16 + hex;
+  }
+  return uni_ch;
+}
+
+template <typename String, typename Iter> inline bool _parse_codepoint(String &out, input<Iter> &in) {
+  int uni_ch;
+  if ((uni_ch = _parse_quadhex(in)) == -1) {
+    return false;
+  }
+  if (0xd800 <= uni_ch && uni_ch <= 0xdfff) {
+    if (0xdc00 <= uni_ch) {
+      // a second 16-bit of a surrogate pair appeared
+      return false;
+    }
+    // first 16-bit of surrogate pair, get the next one
+    if (in.getc() != '\\' || in.getc() != 'u') {
+      in.ungetc();
+      return false;
+    }
+    int second = _parse_quadhex(in);
+    if (!(0xdc00 <= second && second <= 0xdfff)) {
+      return false;
+    }
+    uni_ch = ((uni_ch - 0xd800) << 10) | ((second - 0xdc00) & 0x3ff);
+    uni_ch += 0x10000;
+  }
+  if (uni_ch < 0x80) {
+    out.push_back(static_cast<char>(uni_ch));
+  } else {
+    if (uni_ch < 0x800) {
+      out.push_back(static_cast<char>(0xc0 | (uni_ch >> 6)));
+    } else {
+      if (uni_ch < 0x10000) {
+        out.push_back(static_cast<char>(0xe0 | (uni_ch >> 12)));
+      } else {
+        out.push_back(static_cast<char>(0xf0 | (uni_ch >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((uni_ch >> 12) & 0x3f)));
+      }
+      out.push_back(static_cast<char>(0x80 | ((uni_ch >> 6) & 0x3f)));
+    }
+    out.push_back(static_cast<char>(0x80 | (uni_ch & 0x3f)));
+  }
+  return true;
+}
+
+template <typename String, typename Iter> inline bool _parse_string(String &out, input<Iter> &in) {
+  while (1) {
+    in.copy_str_run(out);
+    int ch = in.getc();
+    if (ch < ' ') {
+      in.ungetc();
+      return false;
+    } else if (ch == '"') {
+      return true;
+    } else if (ch == '\\') {
+      if ((ch = in.getc()) == -1) {
+        return false;
+      }
+      switch (ch) {
+#define MAP(sym, val)                                                                                                              \
+  case sym:                                                                                                                        \
     out.push_back(val);                                                                                                            \
     break
         MAP('"', '\"');
@@ -841,8 +3404,10 @@ template <typename Context, typename Iter> inline bool _parse_object(Context &ct
   if (in.expect('}')) {
     return ctx.parse_object_stop();
   }
+  // the buffer of the key is reused for each member
+  std::string key;
   do {
-    std::string key;
+    key.clear();
     if (!in.expect('"') || !_parse_string(key, in) || !in.expect(':')) {
       return false;
     }
@@ -853,24 +3418,136 @@ template <typename Context, typename Iter> inline bool _parse_object(Context &ct
   return in.expect('}') && ctx.parse_object_stop();
 }
 
-template <typename Iter> inline std::string _parse_number(input<Iter> &in) {
+template <typename T> struct pow10_t { static const double table[23]; };
+template <typename T>
+const double pow10_t<T>::table[23] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// converts the characters collected by _parse_number; returns false unless they form a number that strtod(3) (or
+// strtoimax(3) in case of int64) would have consumed entirely, which is the syntax accepted by previous versions of picojson
+template <typename Context> inline bool _convert_number(Context &ctx, const char *first, const char *last) {
+  const char *p = first;
+  bool neg = false;
+  if (p != last && (*p == '-' || *p == '+')) {
+    neg = *p++ == '-';
+  }
+  // significand (up to 19 significant digits) and the decimal exponent to be applied to it
+  uint64_t sig = 0;
+  int sig_digits = 0, exp10 = 0;
+  bool has_digits = false, is_integer = true;
+  for (; p != last && '0' <= *p && *p <= '9'; ++p) {
+    has_digits = true;
+    if (sig_digits != 0 || *p != '0') {
+      if (++sig_digits <= 19) {
+        sig = sig * 10 + (*p - '0');
+      }
+    }
+  }
+  if (p != last && *p == '.') {
+    is_integer = false;
+    for (++p; p != last && '0' <= *p && *p <= '9'; ++p) {
+      has_digits = true;
+      if (sig_digits != 0 || *p != '0') {
+        if (++sig_digits <= 19) {
+          sig = sig * 10 + (*p - '0');
+        }
+      }
+      if (sig_digits <= 19 && exp10 > -100000) {
+        --exp10;
+      }
+    }
+  }
+  if (!has_digits) {
+    return false;
+  }
+  if (p != last && (*p == 'e' || *p == 'E')) {
+    is_integer = false;
+    bool exp_neg = false;
+    if (++p != last && (*p == '-' || *p == '+')) {
+      exp_neg = *p++ == '-';
+    }
+    if (p == last || !('0' <= *p && *p <= '9')) {
+      return false;
+    }
+    int e = 0;
+    for (; p != last && '0' <= *p && *p <= '9'; ++p) {
+      if (e < 100000) {
+        e = e * 10 + (*p - '0');
+      }
+    }
+    exp10 += exp_neg ? -e : e;
+  }
+  if (p != last) {
+    return false;
+  }
+#ifdef PICOJSON_USE_INT64
+  if (is_integer && sig_digits <= 19 && sig <= static_cast<uint64_t>(std::numeric_limits<int64_t>::max()) + neg) {
+    ctx.set_int64(neg ? static_cast<int64_t>(0 - sig) : static_cast<int64_t>(sig));
+    return true;
+  }
+#else
+  (void)is_integer;
+#endif
+#if !PICOJSON_USE_FAST_DOUBLE
+  (void)neg;
+#endif
+#if PICOJSON_USE_FAST_DOUBLE
+  // exact when both the significand and the power of ten are representable as doubles (Clinger's fast path)
+  if (sig_digits <= 19 && sig <= (static_cast<uint64_t>(1) << 53) && -22 <= exp10 && exp10 <= 22) {
+    double f = static_cast<double>(sig);
+    if (exp10 < 0) {
+      f /= pow10_t<bool>::table[-exp10];
+    } else {
+      f *= pow10_t<bool>::table[exp10];
+    }
+    ctx.set_number(neg ? -f : f);
+    return true;
+  }
+#endif
+  // slow path
   std::string num_str;
-  while (1) {
-    int ch = in.getc();
-    if (('0' <= ch && ch <= '9') || ch == '+' || ch == '-' || ch == 'e' || ch == 'E') {
-      num_str.push_back(static_cast<char>(ch));
-    } else if (ch == '.') {
+  for (p = first; p != last; ++p) {
+    if (*p == '.') {
 #if PICOJSON_USE_LOCALE
       num_str += localeconv()->decimal_point;
 #else
       num_str.push_back('.');
 #endif
+    } else {
+      num_str.push_back(*p);
+    }
+  }
+  char *endp;
+  double f = strtod(num_str.c_str(), &endp);
+  if (endp != num_str.c_str() + num_str.size()) {
+    return false;
+  }
+  ctx.set_number(f);
+  return true;
+}
+
+template <typename Context, typename Iter> inline bool _parse_number(Context &ctx, input<Iter> &in) {
+  char buf[64];
+  size_t len = 0;
+  std::string long_buf;
+  while (1) {
+    int ch = in.getc();
+    if (('0' <= ch && ch <= '9') || ch == '+' || ch == '-' || ch == 'e' || ch == 'E' || ch == '.') {
+      if (len == sizeof(buf)) {
+        long_buf.append(buf, len);
+        len = 0;
+      }
+      buf[len++] = static_cast<char>(ch);
     } else {
       in.ungetc();
       break;
     }
   }
-  return num_str;
+  if (!long_buf.empty()) {
+    long_buf.append(buf, len);
+    return _convert_number(ctx, long_buf.data(), long_buf.data() + long_buf.size());
+  }
+  return _convert_number(ctx, buf, buf + len);
 }
 
 template <typename Context, typename Iter> inline bool _parse(Context &ctx, input<Iter> &in) {
@@ -896,30 +3573,8 @@ template <typename Context, typename Iter> inline bool _parse(Context &ctx, inpu
     return _parse_object(ctx, in);
   default:
     if (('0' <= ch && ch <= '9') || ch == '-') {
-      double f;
-      char *endp;
       in.ungetc();
-      std::string num_str(_parse_number(in));
-      if (num_str.empty()) {
-        return false;
-      }
-#ifdef PICOJSON_USE_INT64
-      {
-        errno = 0;
-        intmax_t ival = strtoimax(num_str.c_str(), &endp, 10);
-        if (errno == 0 && std::numeric_limits<int64_t>::min() <= ival && ival <= std::numeric_limits<int64_t>::max() &&
-            endp == num_str.c_str() + num_str.size()) {
-          ctx.set_int64(ival);
-          return true;
-        }
-      }
-#endif
-      f = strtod(num_str.c_str(), &endp);
-      if (endp == num_str.c_str() + num_str.size()) {
-        ctx.set_number(f);
-        return true;
-      }
-      return false;
+      return _parse_number(ctx, in);
     }
     break;
   }
@@ -963,13 +3618,65 @@ public:
   }
 };
 
+// whether inserting into a map leaves the values that are already in it in place
+template <typename Map> struct _stable_values { enum { value = 0 }; };
+template <typename Key, typename T, typename Compare, typename Alloc> struct _stable_values<std::map<Key, T, Compare, Alloc> > {
+  enum { value = 1 };
+};
+
+// lets the caller follow a parse of contiguous input: after each item of an array or an object, default_parse_context calls fn
+// with the position of the input once it has reached next, e.g. to release the pages of a mapped file behind it (see
+// parse_file)
+struct _parse_progress {
+  const char *next;
+  void (*fn)(_parse_progress *self, const char *pos);
+};
+
 class default_parse_context {
 protected:
   value *out_;
   size_t depths_;
+  arena *arena_;
+  int flags_;
+  string_pool *pool_;
+  // the items of the arrays (and of the objects, unless they are std::map) that are being parsed into an arena or without
+  // move constructors, which are moved into their container when it is complete (see _staging()); the vector is only grown
+  // by _grow_staged(), so each item is copied only while it is still empty
+  struct _staged {
+    std::string key;
+    value v;
+  };
+  std::vector<_staged> *staged_; // shared by the contexts of the nested values, and owned by the outermost one
+  bool owns_staged_;
+  size_t staged_first_;
+  _parse_progress *progress_;
 
 public:
-  default_parse_context(value *out, size_t depths = DEFAULT_MAX_DEPTHS) : out_(out), depths_(depths) {
+  enum {
+    strings_as_views = 1, // strings without escapes become views of the input, which must outlive *out
+    lazy_containers = 2   // arrays and objects below *out are parsed on first access (see parse_lazy)
+  };
+  default_parse_context(value *out, size_t depths = DEFAULT_MAX_DEPTHS)
+      : out_(out), depths_(depths), arena_(NULL), flags_(0), pool_(NULL), staged_(NULL), owns_staged_(false), staged_first_(0),
+        progress_(NULL) {
+  }
+  // strings, arrays and objects are placement-constructed in the arena, which must outlive *out
+  default_parse_context(value *out, arena *a, size_t depths = DEFAULT_MAX_DEPTHS)
+      : out_(out), depths_(depths), arena_(a), flags_(0), pool_(NULL), staged_(NULL), owns_staged_(false), staged_first_(0),
+        progress_(NULL) {
+  }
+  // arena and pool may be NULL; strings that fit in the pool become views of its copies, which must outlive *out
+  default_parse_context(value *out, arena *a, int flags, size_t depths, string_pool *pool = NULL)
+      : out_(out), depths_(depths), arena_(a), flags_(flags), pool_(pool), staged_(NULL), owns_staged_(false), staged_first_(0),
+        progress_(NULL) {
+  }
+  void _set_progress(_parse_progress *progress) {
+    progress_ = progress;
+  }
+  ~default_parse_context() {
+    if (owns_staged_) {
+      delete staged_;
+    }
   }
   bool set_null() {
     *out_ = value();
@@ -990,65 +3697,299 @@ public:
     return true;
   }
   template <typename Iter> bool parse_string(input<Iter> &in) {
-    *out_ = value(string_type, false);
-    return _parse_string(out_->get<std::string>(), in);
+    const char *first, *last;
+    bool plain;
+    if (in.plain_str(first, last, &plain)) {
+      if (pool_ != NULL && _set_pooled(first, static_cast<size_t>(last - first))) {
+        out_->_set_plain(plain);
+        return true;
+      }
+      if ((flags_ & strings_as_views) != 0) {
+        out_->_init_view(string_view(first, static_cast<size_t>(last - first)));
+      } else {
+        _set_string(first, static_cast<size_t>(last - first));
+      }
+      out_->_set_plain(plain);
+      return true;
+    }
+    _set_container(string_type);
+    if (!_parse_string(out_->get<std::string>(), in)) {
+      return false;
+    }
+    if (pool_ != NULL) {
+      const std::string &str = out_->get<std::string>();
+      if (_set_pooled(str.data(), str.size())) {
+        out_->_check_plain();
+        return true;
+      }
+    }
+    out_->_check_plain();
+    return true;
   }
   bool parse_array_start() {
     if (depths_ == 0)
       return false;
     --depths_;
-    *out_ = value(array_type, false);
+    _set_container(array_type);
+    _start_staging();
     return true;
   }
   template <typename Iter> bool parse_array_item(input<Iter> &in, size_t) {
+    if (_staging()) {
+      return _parse_staged(std::string(), in);
+    }
     array &a = out_->get<array>();
     a.push_back(value());
-    default_parse_context ctx(&a.back(), depths_);
-    return _parse(ctx, in);
+    return _parse_item(a.back(), in);
   }
   bool parse_array_stop(size_t) {
     ++depths_;
+    if (_staging()) {
+      array &a = out_->get<array>();
+      a.reserve(staged_->size() - staged_first_);
+      for (std::vector<_staged>::iterator i = staged_->begin() + staged_first_; i != staged_->end(); ++i) {
+        a.push_back(value());
+        a.back()._swap(i->v);
+      }
+      staged_->resize(staged_first_);
+    }
     return true;
   }
   bool parse_object_start() {
     if (depths_ == 0)
       return false;
-    *out_ = value(object_type, false);
+    _set_container(object_type);
+    if (!_stable_values<object>::value) {
+      _start_staging();
+    }
     return true;
   }
   template <typename Iter> bool parse_object_item(input<Iter> &in, const std::string &key) {
+    if (_staging() && !_stable_values<object>::value) {
+      return _parse_staged(key, in);
+    }
     object &o = out_->get<object>();
-    default_parse_context ctx(&o[key], depths_);
-    return _parse(ctx, in);
+    return _parse_item(o[key], in);
   }
   bool parse_object_stop() {
     ++depths_;
+    if (_staging() && !_stable_values<object>::value) {
+      // all the keys are inserted before any value, as inserting into a flat map may move the values that precede it
+      object &o = out_->get<object>();
+      std::vector<_staged>::iterator first = staged_->begin() + staged_first_;
+      for (std::vector<_staged>::iterator i = first; i != staged_->end(); ++i) {
+        o[i->key];
+      }
+      for (std::vector<_staged>::iterator i = first; i != staged_->end(); ++i) {
+        o[i->key]._swap(i->v);
+      }
+      staged_->resize(staged_first_);
+    }
     return true;
   }
 
 private:
-  default_parse_context(const default_parse_context &);
-  default_parse_context &operator=(const default_parse_context &);
-};
-
-class null_parse_context {
-protected:
-  size_t depths_;
-
-public:
-  struct dummy_str {
-    void push_back(int) {
+  // the arrays of a document are allocated at their final size, and without move constructors growing a container would copy
+  // the values that are already in it; copying a string that refers to the input, or an unparsed container, would make it
+  // parse the chars it refers to
+  bool _staging() const {
+    return arena_ != NULL || !PICOJSON_USE_RVALUE_REFERENCE;
+  }
+  void _start_staging() {
+    if (_staging()) {
+      if (staged_ == NULL) {
+        staged_ = new std::vector<_staged>();
+        owns_staged_ = true;
+      }
+      staged_first_ = staged_->size();
     }
-  };
-
-public:
-  null_parse_context(size_t depths = DEFAULT_MAX_DEPTHS) : depths_(depths) {
   }
-  bool set_null() {
-    return true;
+  void _grow_staged() {
+    std::vector<_staged> t;
+    t.reserve(staged_->capacity() * 2 + 16);
+    t.resize(staged_->size());
+    for (size_t i = 0; i != t.size(); ++i) {
+      t[i].key.swap((*staged_)[i].key);
+      t[i].v._swap((*staged_)[i].v);
+    }
+    staged_->swap(t);
   }
-  bool set_bool(bool) {
-    return true;
+  // the item is parsed into a local value, as the nested containers stage their own items meanwhile
+  template <typename Iter> bool _parse_staged(const std::string &key, input<Iter> &in) {
+    value v;
+    bool ok = _parse_item(v, in);
+    if (staged_->size() == staged_->capacity()) {
+      _grow_staged();
+    }
+    staged_->push_back(_staged());
+    staged_->back().key = key;
+    staged_->back().v._swap(v);
+    return ok;
+  }
+  template <typename Iter> bool _parse_item(value &out, input<Iter> &in) {
+#if !PICOJSON_USE_NAN_BOXING
+    const char *first, *last;
+    // a container that is nested too deeply is parsed, which reports the error where parse() does
+    if ((flags_ & lazy_containers) != 0 && in.raw_container(first, last, depths_)) {
+      if (static_cast<size_t>(last - first) <= std::numeric_limits<uint32_t>::max() &&
+          depths_ <= std::numeric_limits<unsigned char>::max()) {
+        out._init_lazy(*first == '[' ? array_type : object_type, first, static_cast<size_t>(last - first), depths_);
+        return true;
+      }
+      input<const char *> range(first, last);
+      default_parse_context ctx(&out, arena_, flags_, depths_, pool_);
+      ctx.staged_ = staged_;
+      return _parse(ctx, range);
+    }
+#endif
+    default_parse_context ctx(&out, arena_, flags_, depths_, pool_);
+    ctx.staged_ = staged_;
+    ctx.progress_ = progress_;
+    if (!_parse(ctx, in)) {
+      return false;
+    }
+    _progressed(in);
+    return true;
+  }
+  template <typename Iter> void _progressed(input<Iter> &) {
+  }
+  void _progressed(input<const char *> &in) {
+    if (progress_ != NULL && in.cur() >= progress_->next) {
+      progress_->fn(progress_, in.cur());
+    }
+  }
+  void _set_container(int type) {
+    if (arena_ != NULL) {
+      value v(type, *arena_);
+      out_->_swap(v);
+    } else {
+      value v(type, false);
+      out_->_swap(v);
+    }
+  }
+  bool _set_pooled(const char *s, size_t len) {
+#if PICOJSON_USE_NAN_BOXING
+    // a view does not fit in the value
+    (void)s;
+    (void)len;
+    return false;
+#else
+    string_view pooled;
+    if (!pool_->intern(s, len, pooled)) {
+      return false;
+    }
+    out_->_init_view(pooled);
+    return true;
+#endif
+  }
+  void _set_string(const char *s, size_t len) {
+    if (arena_ != NULL) {
+      value v(s, len, *arena_);
+      out_->_swap(v);
+    } else {
+      value v(s, len);
+      out_->_swap(v);
+    }
+  }
+  default_parse_context(const default_parse_context &);
+  default_parse_context &operator=(const default_parse_context &);
+};
+
+// decodes the strings inside the input buffer, overwriting their escaped form, and makes the values refer to them
+class insitu_parse_context : public default_parse_context {
+public:
+  class insitu_str {
+    char *first_, *last_;
+
+  public:
+    explicit insitu_str(char *p) : first_(p), last_(p) {
+    }
+    // the decoded form of a string is never longer than its escaped form, so the chars are written at or before the input
+    // position
+    void push_back(int ch) {
+      *last_++ = static_cast<char>(ch);
+    }
+    void append(const char *first, const char *last) {
+      if (last_ != first) {
+        memmove(last_, first, static_cast<size_t>(last - first));
+      }
+      last_ += last - first;
+    }
+    string_view view() const {
+      return string_view(first_, static_cast<size_t>(last_ - first_));
+    }
+  };
+
+public:
+  insitu_parse_context(value *out, size_t depths = DEFAULT_MAX_DEPTHS) : default_parse_context(out, NULL, strings_as_views, depths) {
+  }
+  bool parse_string(input<char *> &in) {
+    const char *first, *last;
+    bool plain;
+    if (in.plain_str(first, last, &plain)) {
+      out_->_init_view(string_view(first, static_cast<size_t>(last - first)));
+      out_->_set_plain(plain);
+      return true;
+    }
+    insitu_str s(in.cur());
+    if (!_parse_string(s, in)) {
+      return false;
+    }
+    out_->_init_view(s.view());
+    out_->_check_plain();
+    return true;
+  }
+  bool parse_array_item(input<char *> &in, size_t) {
+    array &a = out_->get<array>();
+#if !PICOJSON_USE_RVALUE_REFERENCE
+    if (a.size() == a.capacity()) {
+      // the elements are swapped into the larger buffer, so that the views are not copied
+      array grown;
+      grown.reserve(a.size() * 2 + 1);
+      grown.resize(a.size());
+      for (size_t i = 0; i != a.size(); ++i) {
+        grown[i]._swap(a[i]);
+      }
+      a.swap(grown);
+    }
+#endif
+    a.push_back(value());
+    insitu_parse_context ctx(&a.back(), depths_);
+    return _parse(ctx, in);
+  }
+  bool parse_object_item(input<char *> &in, const std::string &key) {
+    object &o = out_->get<object>();
+    insitu_parse_context ctx(&o[key], depths_);
+    return _parse(ctx, in);
+  }
+
+private:
+  insitu_parse_context(const insitu_parse_context &);
+  insitu_parse_context &operator=(const insitu_parse_context &);
+};
+
+inline void _append(insitu_parse_context::insitu_str &out, const char *first, const char *last) {
+  out.append(first, last);
+}
+
+class null_parse_context {
+protected:
+  size_t depths_;
+
+public:
+  struct dummy_str {
+    void push_back(int) {
+    }
+  };
+
+public:
+  null_parse_context(size_t depths = DEFAULT_MAX_DEPTHS) : depths_(depths) {
+  }
+  bool set_null() {
+    return true;
+  }
+  bool set_bool(bool) {
+    return true;
   }
 #ifdef PICOJSON_USE_INT64
   bool set_int64(int64_t) {
@@ -1101,23 +4042,502 @@ template <typename Iter> inline std::string parse(value &out, Iter &pos, const I
   return err;
 }
 
+// reports a syntax error at the current position, consuming the rest of the line
+template <typename Iter> inline void _syntax_error(input<Iter> &in, std::string *err, int line_offset = 0) {
+  char buf[64];
+  SNPRINTF(buf, sizeof(buf), "syntax error at line %d near: ", in.line() + line_offset);
+  *err = buf;
+  while (1) {
+    int ch = in.getc();
+    if (ch == -1 || ch == '\n') {
+      break;
+    } else if (ch >= ' ') {
+      err->push_back(static_cast<char>(ch));
+    }
+  }
+}
+
 template <typename Context, typename Iter> inline Iter _parse(Context &ctx, const Iter &first, const Iter &last, std::string *err) {
   input<Iter> in(first, last);
   if (!_parse(ctx, in) && err != NULL) {
-    char buf[64];
-    SNPRINTF(buf, sizeof(buf), "syntax error at line %d near: ", in.line());
-    *err = buf;
-    while (1) {
-      int ch = in.getc();
-      if (ch == -1 || ch == '\n') {
+    _syntax_error(in, err);
+  }
+  return in.cur();
+}
+
+// pull interface; next() returns the tokens of a JSON value one by one, without building a tree
+template <typename Iter> class reader {
+public:
+  enum {
+    error,          // syntax error (see get_error()); returned until the reader is destroyed
+    end_of_value,   // the value has been read completely; the input is left just after it
+    begin_array,    // '['; skip() skips to the matching ']'
+    end_array,      // ']'
+    begin_object,   // '{'; skip() skips to the matching '}'
+    end_object,     // '}'
+    key,            // key of a member, see get_string_view(); skip() skips its value
+    null_value,     // null
+    boolean_value,  // see get_bool()
+    number_value,   // see get_number() (and get_int64() if the number is an integer that fits in int64_t)
+    string_value    // see get_string_view()
+  };
+
+protected:
+  class scalar_context {
+    reader *r_;
+
+  public:
+    explicit scalar_context(reader *r) : r_(r) {
+    }
+    bool set_null() {
+      r_->token_ = null_value;
+      return true;
+    }
+    bool set_bool(bool b) {
+      r_->token_ = boolean_value;
+      r_->boolean_ = b;
+      return true;
+    }
+#ifdef PICOJSON_USE_INT64
+    bool set_int64(int64_t i) {
+      r_->token_ = number_value;
+      r_->is_int64_ = true;
+      r_->int64_ = i;
+      r_->number_ = static_cast<double>(i);
+      return true;
+    }
+#endif
+    bool set_number(double f) {
+      r_->token_ = number_value;
+      r_->is_int64_ = false;
+      r_->number_ = f;
+      return true;
+    }
+    template <typename It> bool parse_string(input<It> &in) {
+      r_->token_ = string_value;
+      return r_->_read_string(in);
+    }
+    bool parse_array_start() {
+      return false;
+    }
+    template <typename It> bool parse_array_item(input<It> &, size_t) {
+      return false;
+    }
+    bool parse_array_stop(size_t) {
+      return false;
+    }
+    bool parse_object_start() {
+      return false;
+    }
+    template <typename It> bool parse_object_item(input<It> &, const std::string &) {
+      return false;
+    }
+    bool parse_object_stop() {
+      return false;
+    }
+  };
+
+  input<Iter> in_;
+  std::vector<char> stack_; // '[' or '{' for each container being read
+  int token_;
+  bool started_, first_item_;
+  bool boolean_, is_int64_;
+  double number_;
+  int64_t int64_;
+  std::string buf_;
+  string_view str_;
+  std::string err_;
+
+public:
+  reader(const Iter &first, const Iter &last)
+      : in_(first, last), stack_(), token_(end_of_value), started_(false), first_item_(false), boolean_(false), is_int64_(false),
+        number_(0), int64_(0), buf_(), str_(), err_() {
+  }
+  // reads the next token
+  int next() {
+    if (token_ == error) {
+      return error;
+    }
+    if (stack_.empty()) {
+      if (started_) {
+        return token_ = end_of_value;
+      }
+      started_ = true;
+      return _read_value();
+    }
+    bool in_object = stack_.back() == '{';
+    if (token_ == key) {
+      return in_.expect(':') ? _read_value() : _error();
+    }
+    if (in_.expect(in_object ? '}' : ']')) {
+      stack_.pop_back();
+      first_item_ = false;
+      return token_ = in_object ? end_object : end_array;
+    }
+    if (!first_item_ && !in_.expect(',')) {
+      return _error();
+    }
+    first_item_ = false;
+    if (in_object) {
+      if (!in_.expect('"') || !_read_string(in_)) {
+        return _error();
+      }
+      return token_ = key;
+    }
+    return _read_value();
+  }
+  // skips the contents of the array or object just begun, or the value of the key just read, without building them; the next
+  // call to next() returns the token that follows them
+  bool skip() {
+    // the containers that are open count against the nesting limit, except the one just begun, which _parse_array or
+    // _parse_object counts again
+    size_t open = stack_.size() - (token_ == begin_array || token_ == begin_object ? 1 : 0);
+    null_parse_context ctx(DEFAULT_MAX_DEPTHS - open);
+    switch (token_) {
+    case begin_array:
+    case begin_object:
+      if (!(token_ == begin_array ? _parse_array(ctx, in_) : _parse_object(ctx, in_))) {
+        _error();
+        return false;
+      }
+      token_ = token_ == begin_array ? end_array : end_object;
+      stack_.pop_back();
+      first_item_ = false;
+      return true;
+    case key:
+      if (!in_.expect(':') || !_parse(ctx, in_)) {
+        _error();
+        return false;
+      }
+      token_ = null_value;
+      return true;
+    default:
+      return token_ != error;
+    }
+  }
+  // the nesting level of the current position; 0 once the value is complete
+  size_t depth() const {
+    return stack_.size();
+  }
+  bool get_bool() const {
+    PICOJSON_ASSERT("token mismatch" && token_ == boolean_value);
+    return boolean_;
+  }
+  double get_number() const {
+    PICOJSON_ASSERT("token mismatch" && token_ == number_value);
+    return number_;
+  }
+#ifdef PICOJSON_USE_INT64
+  bool is_int64() const {
+    return token_ == number_value && is_int64_;
+  }
+  int64_t get_int64() const {
+    PICOJSON_ASSERT("token mismatch" && is_int64());
+    return int64_;
+  }
+#endif
+  // the chars of a string or a key; valid until the next call to next()
+  string_view get_string_view() const {
+    PICOJSON_ASSERT("token mismatch" && (token_ == string_value || token_ == key));
+    return str_;
+  }
+  std::string get_string() const {
+    return get_string_view().str();
+  }
+  const std::string &get_error() const {
+    return err_;
+  }
+  Iter cur() const {
+    return in_.cur();
+  }
+
+protected:
+  int _read_value() {
+    in_.skip_ws();
+    int ch = in_.getc();
+    if (ch == '[' || ch == '{') {
+      if (stack_.size() == DEFAULT_MAX_DEPTHS) {
+        in_.ungetc();
+        return _error();
+      }
+      stack_.push_back(static_cast<char>(ch));
+      first_item_ = true;
+      return token_ = ch == '[' ? begin_array : begin_object;
+    }
+    in_.ungetc();
+    scalar_context ctx(this);
+    if (!_parse(ctx, in_)) {
+      return _error();
+    }
+    return token_;
+  }
+  bool _read_string(input<Iter> &in) {
+    const char *first, *last;
+    if (in.plain_str(first, last)) {
+      str_ = string_view(first, static_cast<size_t>(last - first));
+      return true;
+    }
+    buf_.clear();
+    if (!_parse_string(buf_, in)) {
+      return false;
+    }
+    str_ = buf_;
+    return true;
+  }
+  int _error() {
+    _syntax_error(in_, &err_);
+    return token_ = error;
+  }
+};
+
+// parses a value that arrives in pieces; feed() may stop in the middle of any token, and keeps only the open containers and
+// the part of the current token read so far
+class incremental_parser {
+protected:
+  enum { _value, _first_item, _after_value, _first_key, _key, _colon, _done, _failed };
+  enum { _no_token, _string_token, _key_token, _number_token, _literal_token };
+  value *out_;
+  std::vector<value *> stack_; // the open arrays and objects
+  std::string token_, key_, err_;
+  size_t depths_, position_;
+  int state_, token_kind_, line_;
+  bool escaped_;
+
+public:
+  explicit incremental_parser(value *out, size_t depths = DEFAULT_MAX_DEPTHS)
+      : out_(out), depths_(depths), position_(0), state_(_value), token_kind_(_no_token), line_(1), escaped_(false) {
+  }
+  // starts parsing another value, keeping the buffers
+  void reset(value *out) {
+    out_ = out;
+    stack_.clear();
+    token_.clear();
+    key_.clear();
+    err_.clear();
+    position_ = 0;
+    state_ = _value;
+    token_kind_ = _no_token;
+    line_ = 1;
+    escaped_ = false;
+  }
+  // returns last if more input is needed; otherwise the value has been read (the rest of the input is not part of it) or an
+  // error has occurred
+  const char *feed(const char *first, const char *last) {
+    const char *p = _feed(first, last);
+    position_ += static_cast<size_t>(p - first);
+    return p;
+  }
+  // tells the parser that the input has ended; returns if a value has been read
+  bool finish() {
+    if (state_ < _done) {
+      if (token_kind_ == _number_token || token_kind_ == _literal_token) {
+        _end_token(NULL, NULL, NULL);
+      }
+      if (state_ < _done) {
+        _error(NULL, NULL);
+      }
+    }
+    return state_ == _done;
+  }
+  bool done() const {
+    return state_ == _done;
+  }
+  const std::string &get_error() const {
+    return err_;
+  }
+  // the number of chars fed since the construction or reset() that are part of the value, up to the error if there is one
+  size_t position() const {
+    return position_;
+  }
+  // the number of open arrays and objects
+  size_t depth() const {
+    return stack_.size();
+  }
+  // the line of the next char to be fed, counting from 1
+  int line() const {
+    return line_;
+  }
+
+protected:
+  const char *_feed(const char *first, const char *last) {
+    const char *p = first;
+    while (p != last && state_ < _done) {
+      if (token_kind_ != _no_token) {
+        p = _read_token(p, p, last);
+        continue;
+      }
+      int ch = *p & 0xff;
+      if (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r') {
+        if (ch == '\n') {
+          ++line_;
+        }
+        ++p;
+        continue;
+      }
+      switch (state_) {
+      case _value:
+      case _first_item:
+        if (ch == '[' || ch == '{') {
+          if (stack_.size() == depths_) {
+            return _error(p, last);
+          }
+          value *slot = _slot();
+          value v(ch == '[' ? array_type : object_type, false);
+          slot->swap(v);
+          stack_.push_back(slot);
+          state_ = ch == '[' ? _first_item : _first_key;
+        } else if (ch == ']' && state_ == _first_item) {
+          _close();
+        } else if (ch == '"') {
+          token_kind_ = _string_token;
+        } else if (('0' <= ch && ch <= '9') || ch == '-') {
+          token_kind_ = _number_token;
+        } else if (ch == 'n' || ch == 't' || ch == 'f') {
+          token_kind_ = _literal_token;
+        } else {
+          return _error(p, last);
+        }
+        break;
+      case _after_value: {
+        bool in_array = stack_.back()->is<array>();
+        if (ch == ',') {
+          state_ = in_array ? _value : _key;
+        } else if (ch == (in_array ? ']' : '}')) {
+          _close();
+        } else {
+          return _error(p, last);
+        }
+      } break;
+      case _first_key:
+      case _key:
+        if (ch == '"') {
+          token_kind_ = _key_token;
+        } else if (ch == '}' && state_ == _first_key) {
+          _close();
+        } else {
+          return _error(p, last);
+        }
+        break;
+      case _colon:
+        if (ch != ':') {
+          return _error(p, last);
+        }
+        state_ = _value;
         break;
-      } else if (ch >= ' ') {
-        err->push_back(static_cast<char>(ch));
+      }
+      if (token_kind_ != _no_token) {
+        escaped_ = false;
+        p = _read_token(p, p + 1, last);
+      } else {
+        ++p;
       }
     }
+    return p;
   }
-  return in.cur();
-}
+  // start is where the part of the token in this chunk begins
+  const char *_read_token(const char *start, const char *p, const char *last) {
+    if (token_kind_ == _string_token || token_kind_ == _key_token) {
+      while (p != last) {
+        if (escaped_) {
+          escaped_ = false;
+          ++p;
+        } else if ((p = _find_str_end(p, last)) != last) {
+          // a control character ends the token as well, so that the error is found where parse() finds it
+          if (*p++ != '\\') {
+            return _end_token(start, p, last);
+          }
+          escaped_ = true;
+        }
+      }
+    } else if (token_kind_ == _number_token) {
+      for (; p != last; ++p) {
+        int ch = *p & 0xff;
+        if (!(('0' <= ch && ch <= '9') || ch == '+' || ch == '-' || ch == 'e' || ch == 'E' || ch == '.')) {
+          return _end_token(start, p, last);
+        }
+      }
+    } else {
+      // null, true or false; the characters are checked once all have been read
+      size_t rest = ((token_.empty() ? *start : token_[0]) == 'f' ? 5 : 4) - token_.size() - static_cast<size_t>(p - start);
+      if (static_cast<size_t>(last - p) >= rest) {
+        return _end_token(start, p + rest, last);
+      }
+      p = last;
+    }
+    token_.append(start, p);
+    return p;
+  }
+  // parses the token, which is [first, last) unless a part of it has been kept from the previous chunks, and the chunk ends at
+  // chunk_last; returns last, or the position of the error
+  const char *_end_token(const char *first, const char *last, const char *chunk_last) {
+    const char *token_first = first, *token_last = last;
+    if (!token_.empty()) {
+      token_.append(first, last);
+      token_first = token_.data();
+      token_last = token_first + token_.size();
+    }
+    bool is_key = token_kind_ == _key_token;
+    token_kind_ = _no_token;
+    input<const char *> in(token_first + (is_key ? 1 : 0), token_last);
+    if (is_key) {
+      key_.clear();
+      if (!_parse_string(key_, in) || in.cur() != token_last) {
+        return _token_error(in.cur() - token_first, first, last, chunk_last);
+      }
+      state_ = _colon;
+    } else {
+      default_parse_context ctx(_slot());
+      if (!_parse(ctx, in) || in.cur() != token_last) {
+        return _token_error(in.cur() - token_first, first, last, chunk_last);
+      }
+      _end_value();
+    }
+    token_.clear();
+    return last;
+  }
+  // reports an error at offset off of the token, whose part in this chunk is [first, last)
+  const char *_token_error(std::ptrdiff_t off, const char *first, const char *last, const char *chunk_last) {
+    size_t kept = token_.empty() ? 0 : token_.size() - static_cast<size_t>(last - first);
+    if (static_cast<size_t>(off) >= kept) {
+      return _error(first + (static_cast<size_t>(off) - kept), chunk_last);
+    }
+    // the error is in a part of the token read from a previous chunk
+    position_ -= kept - static_cast<size_t>(off);
+    std::string rest(token_, static_cast<size_t>(off));
+    rest.append(last, chunk_last);
+    _error(rest.data(), rest.data() + rest.size());
+    return first;
+  }
+  value *_slot() {
+    if (stack_.empty()) {
+      return out_;
+    }
+    value *parent = stack_.back();
+    if (parent->is<array>()) {
+      array &a = parent->get<array>();
+      a.push_back(value());
+      return &a.back();
+    }
+    return &parent->get<object>()[key_];
+  }
+  void _close() {
+    stack_.pop_back();
+    _end_value();
+  }
+  void _end_value() {
+    state_ = stack_.empty() ? _done : _after_value;
+  }
+  const char *_error(const char *p, const char *last) {
+    input<const char *> in(p, last);
+    _syntax_error(in, &err_, line_ - 1);
+    state_ = _failed;
+    return p;
+  }
+
+private:
+  incremental_parser(const incremental_parser &);
+  incremental_parser &operator=(const incremental_parser &);
+};
 
 template <typename Iter> inline Iter parse(value &out, const Iter &first, const Iter &last, std::string *err) {
   default_parse_context ctx(&out);
@@ -1130,9 +4550,1514 @@ inline std::string parse(value &out, const std::string &s) {
   return err;
 }
 
-inline std::string parse(value &out, std::istream &is) {
+// like the above, but a string of up to pool.max_length() chars becomes a view of its copy in the pool, which must outlive
+// out unless detach() is called on it
+template <typename Iter>
+inline Iter parse(value &out, const Iter &first, const Iter &last, string_pool &pool, std::string *err) {
+  default_parse_context ctx(&out, NULL, 0, DEFAULT_MAX_DEPTHS, &pool);
+  return _parse(ctx, first, last, err);
+}
+
+inline std::string parse(value &out, const std::string &s, string_pool &pool) {
+  std::string err;
+  parse(out, s.begin(), s.end(), pool, &err);
+  return err;
+}
+
+// the readers of _read_chunks; read() returns 0 at the end of the input, and unread() gives back the chars that follow the
+// value, returning how many of the first of them could not be given back
+class _streambuf_source {
+  std::streambuf *sb_;
+
+public:
+  explicit _streambuf_source(std::streambuf *sb) : sb_(sb) {
+  }
+  // reads only what is in the get area, so that it can be put back
+  size_t read(char *buf, size_t size) {
+    if (std::char_traits<char>::eq_int_type(sb_->sgetc(), std::char_traits<char>::eof())) {
+      return 0;
+    }
+    std::streamsize n = std::min(sb_->in_avail(), static_cast<std::streamsize>(size));
+    return static_cast<size_t>(sb_->sgetn(buf, n > 0 ? n : 1));
+  }
+  size_t unread(const char *p, size_t n) {
+    while (n != 0) {
+      if (std::char_traits<char>::eq_int_type(sb_->sputbackc(p[--n]), std::char_traits<char>::eof())) {
+        return n + 1;
+      }
+    }
+    return 0;
+  }
+};
+
+// the position is moved back if the file is seekable; otherwise the file is read one line at a time, so that only the rest of
+// the line on which the value ends is lost
+class _file_source {
+  FILE *fp_;
+  bool seekable_;
+
+public:
+  explicit _file_source(FILE *fp) : fp_(fp), seekable_(ftell(fp) != -1) {
+  }
+  size_t read(char *buf, size_t size) {
+    if (seekable_) {
+      return fread(buf, 1, size, fp_);
+    }
+    size_t n = 0;
+    for (int ch; n != size && (ch = getc(fp_)) != EOF;) {
+      buf[n++] = static_cast<char>(ch);
+      if (ch == '\n') {
+        break;
+      }
+    }
+    return n;
+  }
+  size_t unread(const char *, size_t n) {
+    return n == 0 || (seekable_ && fseek(fp_, -static_cast<long>(n), SEEK_CUR) == 0) ? 0 : n;
+  }
+};
+
+#if PICOJSON_USE_POSIX
+class _fd_source {
+  int fd_;
+
+public:
+  explicit _fd_source(int fd) : fd_(fd) {
+  }
+  size_t read(char *buf, size_t size) {
+    ssize_t r;
+    while ((r = ::read(fd_, buf, size)) < 0 && errno == EINTR) {
+    }
+    return r > 0 ? static_cast<size_t>(r) : 0;
+  }
+  // reading a pipe or a socket one line at a time would take a system call per char, so the chars cannot be given back there
+  size_t unread(const char *, size_t n) {
+    return n == 0 || lseek(fd_, -static_cast<off_t>(n), SEEK_CUR) != -1 ? 0 : n;
+  }
+};
+#endif
+
+// the chunks of _parse_chunks, which next() returns until the end of the input; they are read into a buffer by Reader
+template <typename Reader> class _read_chunks {
+  Reader &reader_;
+  std::vector<char> buf_;
+
+public:
+  explicit _read_chunks(Reader &reader, size_t chunk_size = 65536) : reader_(reader), buf_(chunk_size) {
+  }
+  bool next(const char *&first, const char *&last) {
+    first = &buf_[0];
+    last = first + reader_.read(&buf_[0], buf_.size());
+    return first != last;
+  }
+  size_t unread(const char *p, size_t n) {
+    return reader_.unread(p, n);
+  }
+};
+
+// parses the chunks as contiguous input; the chars that follow the value are given back, as are those after the line on which
+// an error is found.  Those that cannot be given back are stored in rest unless it is NULL
+template <typename Chunks> inline std::string _parse_chunks(value &out, Chunks &chunks, std::string *rest) {
+  if (rest != NULL) {
+    rest->clear();
+  }
+  incremental_parser parser(&out);
+  const char *first, *last, *p;
+  do {
+    if (!chunks.next(first, last)) {
+      parser.finish();
+      return parser.get_error();
+    }
+    p = parser.feed(first, last);
+  } while (!parser.done() && parser.get_error().empty());
+  std::string err = parser.get_error();
+  if (!err.empty()) {
+    // as parse() does, the rest of the line is consumed and ends the message; it may continue in the following chunks
+    while ((p = std::find(p, last, '\n')) == last && chunks.next(first, last)) {
+      for (p = first; p != last && *p != '\n'; ++p) {
+        if (static_cast<unsigned char>(*p) >= ' ') {
+          err.push_back(*p);
+        }
+      }
+    }
+    if (p != last) {
+      ++p;
+    }
+  }
+  size_t lost = chunks.unread(p, static_cast<size_t>(last - p));
+  if (rest != NULL) {
+    rest->assign(p, lost);
+  }
+  return err;
+}
+
+inline std::string parse(value &out, std::istream &is) {
+  _streambuf_source src(is.rdbuf());
+  _read_chunks<_streambuf_source> chunks(src);
+  return _parse_chunks(out, chunks, NULL);
+}
+
+// the chars that were read after the value but cannot be given back, because fp is not seekable, are stored in rest; they are
+// at most the rest of the line, and may be only whitespace
+inline std::string parse(value &out, FILE *fp, std::string *rest = NULL) {
+  _file_source src(fp);
+  _read_chunks<_file_source> chunks(src);
+  return _parse_chunks(out, chunks, rest);
+}
+
+#if PICOJSON_USE_POSIX
+// as parse(value &, FILE *, std::string *), but the input is read in chunks even if fd is not seekable, so rest may hold
+// several lines
+inline std::string parse_fd(value &out, int fd, std::string *rest = NULL) {
+  _fd_source src(fd);
+  _read_chunks<_fd_source> chunks(src);
+  return _parse_chunks(out, chunks, rest);
+}
+#endif
+
+#if PICOJSON_USE_POSIX
+// a file opened by parse_file, which is mapped into memory if it is a regular file
+class _input_file {
+  int fd_;
+  void *addr_;
+  size_t size_;
+
+public:
+  explicit _input_file(const char *path) : fd_(open(path, O_RDONLY)), addr_(MAP_FAILED), size_(0) {
+    struct stat st;
+    if (fd_ == -1 || fstat(fd_, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 ||
+        static_cast<uint64_t>(st.st_size) > std::numeric_limits<size_t>::max()) {
+      return;
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    if ((addr_ = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd_, 0)) != MAP_FAILED) {
+      // the pages are read once, in order
+      madvise(addr_, size_, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+      madvise(addr_, size_, MADV_HUGEPAGE);
+#endif
+    }
+  }
+  ~_input_file() {
+    if (addr_ != MAP_FAILED) {
+      munmap(addr_, size_);
+    }
+    if (fd_ != -1) {
+      close(fd_);
+    }
+  }
+  int fd() const {
+    return fd_;
+  }
+  bool mapped() const {
+    return addr_ != MAP_FAILED;
+  }
+  // parses the mapped file as contiguous input, releasing the pages that have been parsed
+  std::string parse(value &out) {
+    const char *first = static_cast<const char *>(addr_);
+    _releaser releaser;
+    releaser.released = first;
+    releaser.next = first + _releaser::slice_size;
+    releaser.fn = &_releaser::release;
+    default_parse_context ctx(&out);
+    ctx._set_progress(&releaser);
+    std::string err;
+    _parse(ctx, first, first + size_, &err);
+    return err;
+  }
+
+private:
+  // releases the pages behind the parser in slices
+  struct _releaser : _parse_progress {
+    enum { slice_size = 4 * 1024 * 1024 }; // a multiple of the page size
+    const char *released;
+    static void release(_parse_progress *p, const char *pos) {
+      _releaser *self = static_cast<_releaser *>(p);
+      size_t n = static_cast<size_t>(pos - self->released) / slice_size * slice_size;
+      madvise(const_cast<char *>(self->released), n, MADV_DONTNEED);
+      self->released += n;
+      self->next = self->released + slice_size;
+    }
+  };
+  _input_file(const _input_file &);
+  _input_file &operator=(const _input_file &);
+};
+#endif
+
+// parses the file at path, which is mapped into memory with PICOJSON_USE_POSIX if it is a regular file; other files, such as
+// pipes, and all files without PICOJSON_USE_POSIX are read in chunks.  returns if a value has been read; err is set to the
+// syntax error or to the reason the file could not be opened
+inline bool parse_file(value &out, const char *path, std::string *err) {
+  std::string e;
+#if PICOJSON_USE_POSIX
+  _input_file f(path);
+  if (f.fd() == -1) {
+    e = std::string("failed to open ") + path + ": " + strerror(errno);
+  } else if (f.mapped()) {
+    e = f.parse(out);
+  } else {
+    e = parse_fd(out, f.fd());
+  }
+#else
+  FILE *fp = fopen(path, "rb");
+  if (fp == NULL) {
+    e = std::string("failed to open ") + path + ": " + strerror(errno);
+  } else {
+    e = parse(out, fp);
+    fclose(fp);
+  }
+#endif
+  if (err != NULL) {
+    *err = e;
+  }
+  return e.empty();
+}
+
+// strings without escapes become views of the input, which must outlive out unless detach() is called on it (copies of out
+// own their chars); only contiguous input can be viewed, strings read from other iterators are copied
+template <typename Iter> inline Iter parse_view(value &out, const Iter &first, const Iter &last, std::string *err) {
+  default_parse_context ctx(&out, NULL, default_parse_context::strings_as_views, DEFAULT_MAX_DEPTHS);
+  return _parse(ctx, first, last, err);
+}
+
+inline std::string parse_view(value &out, const std::string &s) {
+  std::string err;
+  parse_view(out, s.begin(), s.end(), &err);
+  return err;
+}
+
+#if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1900)
+// the value would refer to a string that is destroyed when the call returns
+std::string parse_view(value &out, const std::string &&s) = delete;
+#endif
+
+// thrown when an array or an object that parse_lazy(..., false) skipped turns out to be invalid as it is accessed; position
+// points to the error in the input, as the value does not know where the input starts
+class lazy_parse_error : public std::runtime_error {
+public:
+  const char *position;
+  lazy_parse_error(const std::string &what, const char *pos) : std::runtime_error(what), position(pos) {
+  }
+};
+
+#if !PICOJSON_USE_NAN_BOXING
+// parses an array or an object that was skipped by parse_lazy into out, with the flags of default_parse_context and the
+// nesting depth that was left to it
+inline void value::_parse_unparsed(value &out, const char *first, size_t len, int flags, size_t depths) {
+  const char *last = first + len;
+  input<const char *> in(first, last);
+  default_parse_context ctx(&out, NULL, flags, depths);
+  bool ok = _parse(ctx, in);
+  const char *end = in.cur();
+  if (!ok || end != last) {
+    // the brackets may have matched, but not as a single value
+    std::string err;
+    char buf[96];
+    SNPRINTF(buf, sizeof(buf), "syntax error at offset %lu of an unparsed %s near: ", static_cast<unsigned long>(end - first),
+             *first == '[' ? "array" : "object");
+    err = buf;
+    for (const char *p = end; p != last && *p != '\n'; ++p) {
+      if (*p >= ' ') {
+        err.push_back(*p);
+      }
+    }
+    throw lazy_parse_error(err, end);
+  }
+}
+
+// its elements are left unparsed in turn, unless the text is a copy, which is freed with the value and therefore parsed fully
+inline void value::_materialize() {
+  value v;
+  _parse_unparsed(v, u_.view_, size_,
+                  rep_ == _rep_lazy ? default_parse_context::strings_as_views | default_parse_context::lazy_containers : 0, depths_);
+  _swap(v);
+}
+#endif
+
+// like parse_view, but the arrays and objects below the root are left unparsed until they are accessed through get<array>(),
+// get<object>() (which are also called by get(), contains(), serialize() and comparison) or detach(); they are skipped by
+// matching their brackets, and a subtree nested deeper than parse() allows is an error.  Unless validate is false, the entire
+// input is checked first; otherwise an error in a subtree is thrown as lazy_parse_error when it is parsed, so the accessors
+// above, even through a const reference, as well as operator== and serialize(), may throw it
+template <typename Iter>
+inline Iter parse_lazy(value &out, const Iter &first, const Iter &last, std::string *err, bool validate = true) {
+  if (validate) {
+    null_parse_context nctx;
+    std::string e;
+    Iter end = _parse(nctx, first, last, &e);
+    if (!e.empty()) {
+      if (err != NULL) {
+        *err = e;
+      }
+      return end;
+    }
+  }
+  default_parse_context ctx(&out, NULL, default_parse_context::strings_as_views | default_parse_context::lazy_containers,
+                            DEFAULT_MAX_DEPTHS);
+  return _parse(ctx, first, last, err);
+}
+
+inline std::string parse_lazy(value &out, const std::string &s, bool validate = true) {
+  std::string err;
+  parse_lazy(out, s.begin(), s.end(), &err, validate);
+  return err;
+}
+
+#if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1900)
+std::string parse_lazy(value &out, const std::string &&s, bool validate = true) = delete;
+#endif
+
+// like parse_view, but strings with escapes are also decoded inside [first, last), which is overwritten
+inline char *parse_insitu(value &out, char *first, char *last, std::string *err) {
+  insitu_parse_context ctx(&out);
+  return _parse(ctx, first, last, err);
+}
+
+#if PICOJSON_USE_THREADS
+struct ndjson_options {
+  size_t threads;    // the number of threads, or 0 for std::thread::hardware_concurrency()
+  bool ordered;      // if the lines are delivered in the order of the input
+  string_pool *pool; // if not NULL, the strings that fit in it are shared by all the lines (see string_pool)
+  ndjson_options() : threads(0), ordered(true), pool(NULL) {
+  }
+};
+
+// parses one line of the input; the errors are reported with the line number within the whole input
+inline bool _parse_line(value &out, const char *first, const char *last, size_t line, string_pool *pool, std::string *err) {
+  input<const char *> in(first, last);
+  default_parse_context ctx(&out, NULL, 0, DEFAULT_MAX_DEPTHS, pool);
+  bool ok;
+  try {
+    ok = _parse(ctx, in);
+  } catch (const std::overflow_error &) {
+    char buf[64];
+    SNPRINTF(buf, sizeof(buf), "number out of range at line %lu", static_cast<unsigned long>(line));
+    *err = buf;
+    return false;
+  }
+  if (ok) {
+    in.skip_ws();
+    ok = in.getc() == -1;
+    in.ungetc();
+  }
+  if (!ok) {
+    _syntax_error(in, err, static_cast<int>(line) - 1);
+  }
+  return ok;
+}
+
+// the number of threads to use when `requested` is 0 means as many as the hardware supports
+inline size_t _thread_count(size_t requested) {
+  size_t threads = requested != 0 ? requested : std::thread::hardware_concurrency();
+  return threads != 0 ? threads : 1;
+}
+
+template <typename Callback> class _ndjson_job {
+  struct line_result {
+    size_t line;
+    value v;
+    std::string err;
+  };
+  struct batch {
+    const char *first, *last;
+    size_t line, lines;
+    bool parsed;
+    std::vector<line_result> results;
+  };
+  std::vector<batch> batches_;
+  Callback &cb_;
+  bool ordered_;
+  string_pool *pool_;
+  size_t window_, next_batch_, next_delivery_, errors_;
+  std::vector<size_t> ready_; // the parsed batches not yet delivered, unless in order
+  bool delivering_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::exception_ptr exception_;
+
+public:
+  // splits [first, last) into batches of whole lines, the first of which is line number `line`
+  _ndjson_job(const char *first, const char *last, size_t line, Callback &cb, const ndjson_options &opts, size_t threads)
+      : cb_(cb), ordered_(opts.ordered), pool_(opts.pool), window_(threads * 4), next_batch_(0), next_delivery_(0), errors_(0),
+        delivering_(false) {
+    const size_t batch_size = 64 * 1024;
+    while (first != last) {
+      batch b;
+      b.first = first;
+      b.last = static_cast<size_t>(last - first) > batch_size ? first + batch_size : last;
+      while (b.last != last && b.last[-1] != '\n') {
+        ++b.last;
+      }
+      b.line = line;
+      b.lines = static_cast<size_t>(std::count(b.first, b.last, '\n')) + 1;
+      b.parsed = false;
+      batches_.push_back(b);
+      line += b.lines - 1;
+      first = b.last;
+    }
+  }
+  size_t run(size_t threads) {
+    if (threads == 1 || batches_.size() <= 1) {
+      // nothing to wait for; the lines are delivered as they are parsed
+      for (size_t i = 0; i != batches_.size(); ++i) {
+        _parse_batch(batches_[i], true);
+      }
+      return errors_;
+    }
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < threads && i < batches_.size(); ++i) {
+      workers.push_back(std::thread(&_ndjson_job::_work, this));
+    }
+    _work();
+    for (size_t i = 0; i != workers.size(); ++i) {
+      workers[i].join();
+    }
+    if (exception_) {
+      std::rethrow_exception(exception_);
+    }
+    return errors_;
+  }
+
+private:
+  void _work() {
+    try {
+      while (1) {
+        size_t i;
+        {
+          std::unique_lock<std::mutex> lock(mutex_);
+          // in order, the parsed batches waiting for an earlier one are limited
+          while (!exception_ && next_batch_ != batches_.size() && ordered_ && next_batch_ >= next_delivery_ + window_) {
+            cond_.wait(lock);
+          }
+          if (exception_ || next_batch_ == batches_.size()) {
+            return;
+          }
+          i = next_batch_++;
+        }
+        _parse_batch(batches_[i], false);
+        std::unique_lock<std::mutex> lock(mutex_);
+        batches_[i].parsed = true;
+        if (!ordered_) {
+          ready_.push_back(i);
+        }
+        // the thread that is delivering also delivers this batch when it is ready
+        if (!delivering_) {
+          _deliver(lock);
+        }
+      }
+    } catch (...) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (!exception_) {
+        exception_ = std::current_exception();
+      }
+      cond_.notify_all();
+    }
+  }
+  void _parse_batch(batch &b, bool deliver) {
+    line_result direct;
+    size_t line = b.line;
+    for (const char *p = b.first; p != b.last; ++line) {
+      const char *eol = static_cast<const char *>(memchr(p, '\n', static_cast<size_t>(b.last - p)));
+      if (eol == NULL) {
+        eol = b.last;
+      }
+      if (_skip_ws(p, eol) != eol) {
+        if (!deliver) {
+          if (b.results.empty()) {
+            b.results.reserve(b.lines);
+          }
+          b.results.push_back(line_result());
+        }
+        line_result &r = deliver ? direct : b.results.back();
+        r.line = line;
+        r.err.clear();
+        _parse_line(r.v, p, eol, line, pool_, &r.err);
+        if (deliver) {
+          errors_ += !r.err.empty();
+          cb_(r.line, r.v, r.err);
+        }
+      }
+      p = eol == b.last ? eol : eol + 1;
+    }
+  }
+  // called with mutex_ held by a thread that becomes the only one delivering until no batch is ready; the callback is called
+  // without the lock, so that the other threads go on parsing
+  void _deliver(std::unique_lock<std::mutex> &lock) {
+    delivering_ = true;
+    std::vector<size_t> ready;
+    while (1) {
+      ready.clear();
+      if (!ordered_) {
+        ready.swap(ready_);
+      } else {
+        for (size_t i = next_delivery_; i != batches_.size() && batches_[i].parsed; ++i) {
+          ready.push_back(i);
+        }
+      }
+      if (ready.empty() || exception_) {
+        break;
+      }
+      lock.unlock();
+      size_t errors = 0;
+      for (size_t i = 0; i != ready.size(); ++i) {
+        std::vector<line_result> results;
+        results.swap(batches_[ready[i]].results);
+        for (size_t j = 0; j != results.size(); ++j) {
+          errors += !results[j].err.empty();
+          cb_(results[j].line, results[j].v, results[j].err);
+        }
+      }
+      lock.lock();
+      errors_ += errors;
+      if (ordered_) {
+        next_delivery_ += ready.size();
+        cond_.notify_all();
+      }
+    }
+    delivering_ = false;
+  }
+  _ndjson_job(const _ndjson_job &);
+  _ndjson_job &operator=(const _ndjson_job &);
+};
+
+// parses each line of newline-delimited JSON (blank lines are skipped) and calls cb(line_number, value &, err) for it, where
+// err is empty unless the line has an error; the lines are parsed on multiple threads, but cb is called by one thread at a
+// time; returns the number of lines that had errors
+template <typename Callback>
+inline size_t parse_ndjson(const char *first, const char *last, Callback &cb, const ndjson_options &opts = ndjson_options()) {
+  size_t threads = _thread_count(opts.threads);
+  _ndjson_job<Callback> job(first, last, 1, cb, opts, threads);
+  return job.run(threads);
+}
+
+template <typename Callback>
+inline size_t parse_ndjson(const std::string &s, Callback &cb, const ndjson_options &opts = ndjson_options()) {
+  return parse_ndjson(s.data(), s.data() + s.size(), cb, opts);
+}
+
+// reads the stream in blocks of whole lines, each of which is parsed like the above before the next is read
+template <typename Callback>
+inline size_t parse_ndjson(std::istream &is, Callback &cb, const ndjson_options &opts = ndjson_options()) {
+  const size_t block_size = 16 * 1024 * 1024;
+  size_t threads = _thread_count(opts.threads), errors = 0, line = 1, len = 0;
+  std::vector<char> buf;
+  while (1) {
+    buf.resize(len + block_size);
+    is.read(&buf[len], static_cast<std::streamsize>(block_size));
+    len += static_cast<size_t>(is.gcount());
+    bool eof = !is;
+    // a block ends after the last newline, unless it is the last one
+    size_t cut = len;
+    if (!eof) {
+      while (cut != 0 && buf[cut - 1] != '\n') {
+        --cut;
+      }
+    }
+    if (cut != 0) {
+      const char *first = &buf[0], *last = first + cut;
+      _ndjson_job<Callback> job(first, last, line, cb, opts, threads);
+      errors += job.run(threads);
+      line += static_cast<size_t>(std::count(first, last, '\n'));
+      std::copy(buf.begin() + static_cast<std::ptrdiff_t>(cut), buf.begin() + static_cast<std::ptrdiff_t>(len), buf.begin());
+      len -= cut;
+    }
+    if (eof) {
+      return errors;
+    }
+  }
+}
+
+// splits the elements of an array into pieces of about piece_size bytes, each of which is (first, last) where first is the
+// beginning of an element and last is the comma or the closing bracket after the piece; p is the position next to the opening
+// bracket; returns the position next to the closing bracket, or NULL if the elements could not be told apart
+inline const char *_split_array(const char *p, const char *end, size_t piece_size,
+                                std::vector<std::pair<const char *, const char *> > &pieces) {
+  const char *piece_first = p = _skip_ws(p, end);
+  if (p != end && *p == ']') {
+    return NULL;
+  }
+  while (p != end) {
+    if (*p == '[' || *p == '{') {
+      if ((p = _skip_container(p, end)) == NULL) {
+        return NULL;
+      }
+    } else if (*p == '"') {
+      if ((p = _skip_str(p + 1, end)) == NULL) {
+        return NULL;
+      }
+    } else {
+      while (p != end && *p != ',' && *p != ']' && (char_class::table[static_cast<unsigned char>(*p)] & char_class::ws) == 0) {
+        ++p;
+      }
+    }
+    if ((p = _skip_ws(p, end)) == end || (*p != ',' && *p != ']')) {
+      return NULL;
+    }
+    if (*p == ']' || static_cast<size_t>(p - piece_first) >= piece_size) {
+      pieces.push_back(std::make_pair(piece_first, p));
+      if (*p == ']') {
+        return p + 1;
+      }
+      piece_first = p + 1;
+    }
+    p = _skip_ws(p + 1, end);
+  }
+  return NULL;
+}
+
+class _parallel_array_job {
+  struct piece {
+    const char *first, *last;
+    array items;
+    const char *err_pos; // NULL unless a syntax error has been found
+    std::string err;
+    std::exception_ptr exception;
+  };
+  const char *begin_, *end_;
+  std::vector<piece> pieces_;
+  size_t next_piece_;
+  std::mutex mutex_;
+
+public:
+  _parallel_array_job(const char *begin, const char *end, const std::vector<std::pair<const char *, const char *> > &pieces)
+      : begin_(begin), end_(end), pieces_(pieces.size()), next_piece_(0) {
+    for (size_t i = 0; i != pieces.size(); ++i) {
+      pieces_[i].first = pieces[i].first;
+      pieces_[i].last = pieces[i].second;
+      pieces_[i].err_pos = NULL;
+    }
+  }
+  void run(size_t threads) {
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < threads && i < pieces_.size(); ++i) {
+      workers.push_back(std::thread(&_parallel_array_job::_work, this));
+    }
+    _work();
+    for (size_t i = 0; i != workers.size(); ++i) {
+      workers[i].join();
+    }
+  }
+  // moves the elements into out, or reports the first error in the input, in the same way as parse(value &, ...)
+  const char *finish(value &out, const char *array_end, std::string *err) {
+    size_t n = 0;
+    for (size_t i = 0; i != pieces_.size(); ++i) {
+      if (pieces_[i].exception) {
+        std::rethrow_exception(pieces_[i].exception);
+      }
+      if (pieces_[i].err_pos != NULL) {
+        if (err != NULL) {
+          err->swap(pieces_[i].err);
+        }
+        return pieces_[i].err_pos;
+      }
+      n += pieces_[i].items.size();
+    }
+    value v(array_type, false);
+    array &a = v.get<array>();
+    a.reserve(n);
+    for (size_t i = 0; i != pieces_.size(); ++i) {
+      array &items = pieces_[i].items;
+      for (size_t j = 0; j != items.size(); ++j) {
+        a.push_back(value());
+        a.back().swap(items[j]);
+      }
+      array().swap(items);
+    }
+    out.swap(v);
+    return array_end;
+  }
+
+private:
+  void _work() {
+    while (1) {
+      size_t i;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (next_piece_ == pieces_.size()) {
+          return;
+        }
+        i = next_piece_++;
+      }
+      try {
+        _parse_piece(pieces_[i]);
+      } catch (...) {
+        pieces_[i].exception = std::current_exception();
+      }
+    }
+  }
+  void _parse_piece(piece &pc) {
+    // the input extends to the end, so that an error is reported with the same text as parse(value &, ...) would
+    input<const char *> in(pc.first, end_);
+    while (1) {
+      pc.items.push_back(value());
+      default_parse_context ctx(&pc.items.back(), NULL, 0, DEFAULT_MAX_DEPTHS - 1);
+      if (!_parse(ctx, in)) {
+        break;
+      }
+      in.skip_ws();
+      if (in.cur() == pc.last) {
+        return;
+      }
+      if (!in.expect(',')) {
+        break;
+      }
+    }
+    _syntax_error(in, &pc.err, static_cast<int>(std::count(begin_, pc.first, '\n')));
+    pc.err_pos = in.cur();
+  }
+  _parallel_array_job(const _parallel_array_job &);
+  _parallel_array_job &operator=(const _parallel_array_job &);
+};
+
+// like parse(value &, ...), but if the value is an array, its elements are parsed on `threads` threads (0 means as many as
+// the hardware supports) and then moved into out
+inline const char *parse_parallel(value &out, const char *first, const char *last, std::string *err, size_t threads = 0) {
+  threads = _thread_count(threads);
+  const char *p = _skip_ws(first, last);
+  if (threads > 1 && p != last && *p == '[') {
+    const size_t min_piece_size = 64 * 1024;
+    size_t piece_size = static_cast<size_t>(last - first) / (threads * 4);
+    std::vector<std::pair<const char *, const char *> > pieces;
+    const char *array_end = _split_array(p + 1, last, piece_size > min_piece_size ? piece_size : min_piece_size, pieces);
+    if (array_end != NULL && pieces.size() > 1) {
+      _parallel_array_job job(first, last, pieces);
+      job.run(threads);
+      return job.finish(out, array_end, err);
+    }
+  }
+  // a small array, or one whose elements could not be told apart (and which therefore has a syntax error)
+  return parse(out, first, last, err);
+}
+
+inline std::string parse_parallel(value &out, const std::string &s, size_t threads = 0) {
+  std::string err;
+  parse_parallel(out, s.data(), s.data() + s.size(), &err, threads);
+  return err;
+}
+
+// serializes a value as a sequence of pieces; the text between the large ranges of elements is written while planning, and
+// the ranges (and the values below small containers) are serialized on the worker threads
+class _serialize_job {
+  enum { _text_piece, _value_piece, _items_piece, _members_piece };
+  struct piece {
+    int kind;
+    std::string out; // written while planning if kind is _text_piece
+    const value *v;
+    array::const_iterator items_first, items_last;
+    object::const_iterator members_first, members_last;
+    bool comma;
+    int indent;
+    piece() : kind(_text_piece), v(NULL), comma(false), indent(-1) {
+    }
+  };
+  std::vector<piece> pieces_;
+  size_t threads_, next_piece_;
+  std::mutex mutex_;
+  std::exception_ptr exception_;
+
+public:
+  _serialize_job(const value &v, bool prettify, size_t threads) : threads_(threads), next_piece_(0) {
+    _plan(v, prettify ? 0 : -1, 0);
+  }
+  void run() {
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < threads_; ++i) {
+      workers.push_back(std::thread(&_serialize_job::_work, this));
+    }
+    _work();
+    for (size_t i = 0; i != workers.size(); ++i) {
+      workers[i].join();
+    }
+    if (exception_) {
+      std::rethrow_exception(exception_);
+    }
+  }
+  template <typename Iter> void write(Iter oi) const {
+    for (size_t i = 0; i != pieces_.size(); ++i) {
+      oi = std::copy(pieces_[i].out.begin(), pieces_[i].out.end(), oi);
+    }
+  }
+  size_t size() const {
+    size_t n = 0;
+    for (size_t i = 0; i != pieces_.size(); ++i) {
+      n += pieces_[i].out.size();
+    }
+    return n;
+  }
+
+private:
+  // indent is as given to value::_serialize; containers are split into ranges if they have enough elements to keep the
+  // threads busy, and the ones with fewer are descended into (up to a limit)
+  void _plan(const value &v, int indent, int depth) {
+    bool is_array = v.is<array>();
+    size_t n = is_array ? v.get<array>().size() : v.is<object>() ? v.get<object>().size() : 0;
+    if (n == 0 || (n < threads_ * 2 && depth >= 8)) {
+      piece &p = _add_piece(_value_piece, v);
+      p.indent = indent;
+      return;
+    }
+    int inner = indent != -1 ? indent + 1 : -1;
+    _text(is_array ? "[" : "{");
+    if (n >= threads_ * 2) {
+      size_t range = n / (threads_ * 8) != 0 ? n / (threads_ * 8) : 1, i = 0;
+      if (is_array) {
+        const array &a = v.get<array>();
+        for (; i < n; i += range) {
+          piece &p = _add_piece(_items_piece, v);
+          p.items_first = a.begin() + static_cast<std::ptrdiff_t>(i);
+          p.items_last = a.begin() + static_cast<std::ptrdiff_t>(n - i > range ? i + range : n);
+          p.comma = i != 0;
+          p.indent = inner;
+        }
+      } else {
+        const object &o = v.get<object>();
+        for (object::const_iterator j = o.begin(); j != o.end(); ++i) {
+          piece &p = _add_piece(_members_piece, v);
+          p.members_first = j;
+          for (size_t k = 0; k != range && j != o.end(); ++k) {
+            ++j;
+          }
+          p.members_last = j;
+          p.comma = i != 0;
+          p.indent = inner;
+        }
+      }
+    } else if (is_array) {
+      const array &a = v.get<array>();
+      for (array::const_iterator i = a.begin(); i != a.end(); ++i) {
+        _separator(i != a.begin(), inner);
+        _plan(*i, inner, depth + 1);
+      }
+    } else {
+      const object &o = v.get<object>();
+      for (object::const_iterator i = o.begin(); i != o.end(); ++i) {
+        _separator(i != o.begin(), inner);
+        std::string &out = _text("");
+        _serialize_str(out, i->first.data(), i->first.data() + i->first.size());
+        out += indent != -1 ? ": " : ":";
+        _plan(i->second, inner, depth + 1);
+      }
+    }
+    if (indent != -1) {
+      value::_indent(_text(""), indent);
+    }
+    _text(is_array ? "]" : "}");
+    if (indent == 0) {
+      _text("\n");
+    }
+  }
+  void _separator(bool comma, int indent) {
+    if (comma) {
+      _text(",");
+    }
+    if (indent != -1) {
+      value::_indent(_text(""), indent);
+    }
+  }
+  // appends to the text written while planning
+  std::string &_text(const char *s) {
+    if (pieces_.empty() || pieces_.back().kind != _text_piece) {
+      pieces_.push_back(piece());
+    }
+    return pieces_.back().out += s;
+  }
+  piece &_add_piece(int kind, const value &v) {
+    pieces_.push_back(piece());
+    pieces_.back().kind = kind;
+    pieces_.back().v = &v;
+    return pieces_.back();
+  }
+  void _work() {
+    try {
+      while (1) {
+        size_t i;
+        {
+          std::unique_lock<std::mutex> lock(mutex_);
+          if (exception_ || next_piece_ == pieces_.size()) {
+            return;
+          }
+          i = next_piece_++;
+        }
+        piece &p = pieces_[i];
+        switch (p.kind) {
+        case _value_piece:
+          p.v->_serialize(p.out, p.indent);
+          break;
+        case _items_piece:
+          value::_serialize_items(p.out, p.items_first, p.items_last, p.comma, p.indent);
+          break;
+        case _members_piece:
+          value::_serialize_members(p.out, p.members_first, p.members_last, p.comma, p.indent);
+          break;
+        }
+      }
+    } catch (...) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (!exception_) {
+        exception_ = std::current_exception();
+      }
+    }
+  }
+  _serialize_job(const _serialize_job &);
+  _serialize_job &operator=(const _serialize_job &);
+};
+
+template <typename Iter> void value::serialize_parallel(Iter oi, bool prettify, size_t threads) const {
+  threads = _thread_count(threads);
+  if (threads == 1) {
+    serialize(oi, prettify);
+    return;
+  }
+  _serialize_job job(*this, prettify, threads);
+  job.run();
+  job.write(oi);
+}
+
+inline std::string value::serialize_parallel(bool prettify, size_t threads) const {
+  threads = _thread_count(threads);
+  if (threads == 1) {
+    return _serialize(prettify ? 0 : -1);
+  }
+  _serialize_job job(*this, prettify, threads);
+  job.run();
+  std::string s;
+  s.reserve(job.size());
+  job.write(std::back_inserter(s));
+  return s;
+}
+#endif
+
+// a parsed tree whose std::string, array and object objects are placement-constructed in an arena owned by the document; the
+// chars, elements and entries they hold are allocated by the containers as usual; swapping or moving a value keeps it in the
+// arena, so a value that is swapped or moved out of the document must not outlive it unless detach() is called on it
+class document {
+  arena arena_;
+  value root_;
+
+public:
+  document() : arena_(), root_() {
+  }
+  value &root() {
+    return root_;
+  }
+  const value &root() const {
+    return root_;
+  }
+  void clear() {
+    root_ = value();
+    arena_.release();
+  }
+  template <typename Iter> Iter parse(const Iter &first, const Iter &last, std::string *err) {
+    clear();
+    default_parse_context ctx(&root_, &arena_);
+    return _parse(ctx, first, last, err);
+  }
+  // like parse_view(value &, ...); the input must outlive the document
+  template <typename Iter> Iter parse_view(const Iter &first, const Iter &last, std::string *err) {
+    clear();
+    default_parse_context ctx(&root_, &arena_, default_parse_context::strings_as_views, DEFAULT_MAX_DEPTHS);
+    return _parse(ctx, first, last, err);
+  }
+
+private:
+  document(const document &);
+  document &operator=(const document &);
+};
+
+template <typename Iter> inline Iter parse(document &out, const Iter &first, const Iter &last, std::string *err) {
+  return out.parse(first, last, err);
+}
+
+inline std::string parse(document &out, const std::string &s) {
+  std::string err;
+  out.parse(s.begin(), s.end(), &err);
+  return err;
+}
+
+inline std::string parse(document &out, std::istream &is) {
+  std::string err;
+  out.parse(std::istreambuf_iterator<char>(is.rdbuf()), std::istreambuf_iterator<char>(), &err);
+  return err;
+}
+
+template <typename Iter> inline Iter parse_view(document &out, const Iter &first, const Iter &last, std::string *err) {
+  return out.parse_view(first, last, err);
+}
+
+inline std::string parse_view(document &out, const std::string &s) {
+  std::string err;
+  out.parse_view(s.begin(), s.end(), &err);
+  return err;
+}
+
+#if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1900)
+std::string parse_view(document &out, const std::string &&s) = delete;
+#endif
+
+class tape_value;
+
+// a read-only tree stored as a flat array of 64-bit words, built by a two-stage parser: the first stage indexes the
+// structural characters of the whole input, and the second walks the index to emit the words (see tape_value for reading)
+class tape {
+  friend class tape_value;
+  // the top 8 bits of a word is its type, and the rest is the payload:
+  //   'n', 't', 'f': null, true, false
+  //   'd', 'l': a double or an int64_t, whose bits are stored in the next word
+  //   '"': offset of the chars in strings_, the length of which is stored in the next word
+  //   '[', '{': index of the word next to the matching ']' or '}', whose payload is the number n of elements or members; the n
+  //   words before the ']' or '}' are the indices of the elements in order, or of the keys of the members, in order if there
+  //   are up to LINEAR_MAX members and otherwise sorted by key (members with the same key stay in order)
+  // word 0 is a null that is returned for elements that do not exist, and the root starts at word 1
+  enum { LINEAR_MAX = 8 };
+  std::vector<uint64_t> words_;
+  std::string strings_;
+  std::vector<uint32_t> index_;
+  std::vector<std::pair<size_t, size_t> > stack_; // index of the word that opened the container, and its first item in items_
+  std::vector<uint64_t> items_;                   // indices of the items of the open containers
+
+  static bool _key_less(const string_view &x, const string_view &y) {
+    int r = memcmp(x.data(), y.data(), std::min(x.size(), y.size()));
+    return r != 0 ? r < 0 : x.size() < y.size();
+  }
+  struct _member_less {
+    const tape *t;
+    explicit _member_less(const tape *t_) : t(t_) {
+    }
+    bool operator()(uint64_t x, uint64_t y) const {
+      return _key_less(t->_key(static_cast<size_t>(x)), t->_key(static_cast<size_t>(y)));
+    }
+  };
+
+  class scalar_context {
+    tape *t_;
+
+  public:
+    explicit scalar_context(tape *t) : t_(t) {
+    }
+    bool set_null() {
+      t_->_push('n', 0);
+      return true;
+    }
+    bool set_bool(bool b) {
+      t_->_push(b ? 't' : 'f', 0);
+      return true;
+    }
+#ifdef PICOJSON_USE_INT64
+    bool set_int64(int64_t i) {
+      t_->_push('l', 0);
+      t_->words_.push_back(static_cast<uint64_t>(i));
+      return true;
+    }
+#endif
+    bool set_number(double f) {
+      _check_finite(f); // as parse(value &, ...) does
+      uint64_t bits;
+      memcpy(&bits, &f, sizeof(bits));
+      t_->_push('d', 0);
+      t_->words_.push_back(bits);
+      return true;
+    }
+    template <typename Iter> bool parse_string(input<Iter> &in) {
+      return t_->_parse_string(in);
+    }
+    bool parse_array_start() {
+      return false;
+    }
+    template <typename Iter> bool parse_array_item(input<Iter> &, size_t) {
+      return false;
+    }
+    bool parse_array_stop(size_t) {
+      return false;
+    }
+    bool parse_object_start() {
+      return false;
+    }
+    template <typename Iter> bool parse_object_item(input<Iter> &, const std::string &) {
+      return false;
+    }
+    bool parse_object_stop() {
+      return false;
+    }
+  };
+
+public:
+  tape() : words_(1, static_cast<uint64_t>('n') << 56), strings_(), index_(), stack_(), items_() {
+  }
+  tape_value root() const;
+  // parses a JSON value that starts in [first, last); returns the position next to the value, or the position of the error
+  const char *parse(const char *first, const char *last, std::string *err);
+
+private:
+  void _push(int type, uint64_t payload) {
+    words_.push_back((static_cast<uint64_t>(type) << 56) | payload);
+  }
+  string_view _key(size_t idx) const {
+    return string_view(strings_.data() + (words_[idx] & 0xffffffffffffffULL), static_cast<size_t>(words_[idx + 1]));
+  }
+  bool _parse_string(input<const char *> &in) {
+    size_t offset = strings_.size();
+    if (!picojson::_parse_string(strings_, in)) {
+      return false;
+    }
+    _push('"', offset);
+    words_.push_back(strings_.size() - offset);
+    return true;
+  }
+  // parses a scalar; within a container, it must be followed by whitespace, a structural character, a quote or the end of input
+  bool _parse_scalar(const char *&p, const char *last) {
+    input<const char *> in(p, last);
+    scalar_context ctx(this);
+    bool ok = picojson::_parse(ctx, in);
+    p = in.cur();
+    return ok && (stack_.empty() || p == last || *p == '"' ||
+                  (char_class::table[static_cast<unsigned char>(*p)] & (char_class::ws | char_class::structural)) != 0);
+  }
+  tape(const tape &);
+  tape &operator=(const tape &);
+};
+
+inline const char *tape::parse(const char *first, const char *last, std::string *err) {
+  words_.resize(1);
+  strings_.clear();
+  stack_.clear();
+  items_.clear();
+  size_t len = static_cast<size_t>(last - first), n = 0, i = 0;
+  const char *p = first, *end = NULL;
+  if (len > std::numeric_limits<uint32_t>::max()) {
+    // the structural index holds 32-bit offsets
+    if (err != NULL) {
+      *err = "input too large for a tape (4 GB or more)";
+    }
+    return first;
+  }
+  n = _index_structurals(first, len, index_);
+#define NEXT()                                                                                                                     \
+  do {                                                                                                                             \
+    if (i == n) {                                                                                                                  \
+      p = last;                                                                                                                    \
+      goto Error;                                                                                                                  \
+    }                                                                                                                              \
+    p = first + index_[i++];                                                                                                       \
+  } while (0)
+  NEXT();
+Value:
+  if (!stack_.empty() && words_[stack_.back().first] >> 56 == '[') {
+    items_.push_back(words_.size());
+  }
+  switch (*p) {
+  case '[':
+  case '{':
+    if (stack_.size() == DEFAULT_MAX_DEPTHS) {
+      goto Error;
+    }
+    stack_.push_back(std::make_pair(words_.size(), items_.size()));
+    _push(*p, 0);
+    NEXT();
+    if (*p == (words_[stack_.back().first] >> 56 == '[' ? ']' : '}')) {
+      goto Close;
+    }
+    if (*p == ']' || *p == '}') {
+      goto Error;
+    }
+    if (words_[stack_.back().first] >> 56 == '{') {
+      goto Key;
+    }
+    goto Value;
+  default:
+    if (!_parse_scalar(p, last)) {
+      goto Error;
+    }
+    end = p;
+    break;
+  }
+AfterValue:
+  if (stack_.empty()) {
+    return end;
+  }
+  NEXT();
+  if (*p == ',') {
+    NEXT();
+    if (words_[stack_.back().first] >> 56 == '{') {
+      goto Key;
+    }
+    goto Value;
+  }
+  if (*p != (words_[stack_.back().first] >> 56 == '[' ? ']' : '}')) {
+    goto Error;
+  }
+Close : {
+  std::vector<uint64_t>::iterator items = items_.begin() + stack_.back().second;
+  size_t count = static_cast<size_t>(items_.end() - items);
+  if (words_[stack_.back().first] >> 56 == '{' && count > LINEAR_MAX) {
+    std::stable_sort(items, items_.end(), _member_less(this));
+  }
+  words_.insert(words_.end(), items, items_.end());
+  items_.erase(items, items_.end());
+  words_[stack_.back().first] |= words_.size() + 1;
+  _push(*p, count);
+  stack_.pop_back();
+  end = p + 1;
+}
+  goto AfterValue;
+Key : {
+  items_.push_back(words_.size());
+  input<const char *> in(p + 1, last);
+  if (*p != '"' || !_parse_string(in)) {
+    p = in.cur();
+    goto Error;
+  }
+}
+  NEXT();
+  if (*p != ':') {
+    goto Error;
+  }
+  NEXT();
+  goto Value;
+#undef NEXT
+
+Error:
+  if (err != NULL) {
+    char buf[64];
+    SNPRINTF(buf, sizeof(buf), "syntax error at line %d near: ", 1 + static_cast<int>(std::count(first, p, '\n')));
+    *err = buf;
+    for (; p != last && *p != '\n'; ++p) {
+      if (*p >= ' ') {
+        err->push_back(*p);
+      }
+    }
+  }
+  words_.resize(1);
+  return p;
+}
+
+// a reference to a value in a tape, which must outlive it
+class tape_value {
+  const tape *tape_;
+  size_t idx_;
+
+public:
+  class const_iterator {
+    const tape *tape_;
+    size_t idx_;
+    bool members_;
+
+  public:
+    const_iterator(const tape *t, size_t idx, bool members) : tape_(t), idx_(idx), members_(members) {
+    }
+    // the element, or the value of the member
+    tape_value operator*() const {
+      return tape_value(tape_, members_ ? idx_ + 2 : idx_);
+    }
+    // the key of the member
+    string_view key() const {
+      PICOJSON_ASSERT("not a member of an object" && members_);
+      return tape_value(tape_, idx_).get_string_view();
+    }
+    const_iterator &operator++() {
+      idx_ = tape_value(tape_, members_ ? idx_ + 2 : idx_)._next();
+      return *this;
+    }
+    bool operator==(const const_iterator &x) const {
+      return idx_ == x.idx_;
+    }
+    bool operator!=(const const_iterator &x) const {
+      return idx_ != x.idx_;
+    }
+  };
+
+  tape_value(const tape *t, size_t idx) : tape_(t), idx_(idx) {
+  }
+  template <typename T> bool is() const;
+  // unlike value::get, returns a copy
+  template <typename T> T get() const;
+  string_view get_string_view() const;
+  // the number of elements of an array or members of an object
+  size_t size() const;
+  const_iterator begin() const;
+  const_iterator end() const;
+  // returns a null if the element or the member does not exist; of the members with the same key, the last is returned, as
+  // parse(value &, ...) keeps the last; both take constant time for an array and logarithmic time for an object
+  tape_value get(const size_t idx) const;
+  tape_value get(const std::string &key) const;
+  bool contains(const size_t idx) const;
+  bool contains(const std::string &key) const;
+  // builds a mutable copy
+  value to_value() const;
+
+private:
+  int _type() const {
+    return static_cast<int>(tape_->words_[idx_] >> 56);
+  }
+  uint64_t _payload() const {
+    return tape_->words_[idx_] & 0xffffffffffffffULL;
+  }
+  // the indices of the elements or of the keys of the members (see tape)
+  const uint64_t *_items() const {
+    return &tape_->words_[static_cast<size_t>(_payload()) - 1 - size()];
+  }
+  size_t _find(const std::string &key) const;
+  static double _double_bits(uint64_t bits) {
+    double f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+  }
+  // index of the word next to this value
+  size_t _next() const {
+    switch (_type()) {
+    case '[':
+    case '{':
+      return static_cast<size_t>(_payload());
+    case '"':
+    case 'd':
+    case 'l':
+      return idx_ + 2;
+    default:
+      return idx_ + 1;
+    }
+  }
+};
+
+inline tape_value tape::root() const {
+  return tape_value(this, words_.size() > 1 ? 1 : 0);
+}
+
+#define IS(ctype, cond)                                                                                                            \
+  template <> inline bool tape_value::is<ctype>() const {                                                                          \
+    int type = _type();                                                                                                            \
+    return cond;                                                                                                                   \
+  }
+IS(null, type == 'n')
+IS(bool, type == 't' || type == 'f')
+#ifdef PICOJSON_USE_INT64
+IS(int64_t, type == 'l')
+#endif
+IS(double, type == 'd' || type == 'l')
+IS(std::string, type == '"')
+IS(array, type == '[')
+IS(object, type == '{')
+#undef IS
+
+#define GET(ctype, var)                                                                                                            \
+  template <> inline ctype tape_value::get<ctype>() const {                                                                        \
+    PICOJSON_ASSERT("type mismatch! call is<type>() before get<type>()" && is<ctype>());                                           \
+    return var;                                                                                                                    \
+  }
+GET(bool, _type() == 't')
+#ifdef PICOJSON_USE_INT64
+GET(int64_t, static_cast<int64_t>(tape_->words_[idx_ + 1]))
+#endif
+GET(double, (_type() == 'l' ? static_cast<double>(static_cast<int64_t>(tape_->words_[idx_ + 1]))
+                            : _double_bits(tape_->words_[idx_ + 1])))
+GET(std::string, get_string_view().str())
+#undef GET
+
+inline string_view tape_value::get_string_view() const {
+  PICOJSON_ASSERT("type mismatch! call is<type>() before get<type>()" && is<std::string>());
+  return string_view(tape_->strings_.data() + _payload(), static_cast<size_t>(tape_->words_[idx_ + 1]));
+}
+
+inline size_t tape_value::size() const {
+  return is<array>() || is<object>() ? static_cast<size_t>(tape_->words_[_payload() - 1] & 0xffffffffffffffULL) : 0;
+}
+
+inline tape_value::const_iterator tape_value::begin() const {
+  return const_iterator(tape_, is<array>() || is<object>() ? idx_ + 1 : idx_, is<object>());
+}
+
+inline tape_value::const_iterator tape_value::end() const {
+  return const_iterator(tape_, is<array>() || is<object>() ? static_cast<size_t>(_payload()) - 1 - size() : idx_, is<object>());
+}
+
+inline tape_value tape_value::get(const size_t idx) const {
+  PICOJSON_ASSERT(is<array>());
+  return tape_value(tape_, idx < size() ? static_cast<size_t>(_items()[idx]) : 0);
+}
+
+// returns the index of the value of the last member with the key, or 0 if there is none
+inline size_t tape_value::_find(const std::string &key) const {
+  const uint64_t *items = _items();
+  size_t n = size();
+  if (n <= tape::LINEAR_MAX) {
+    for (size_t i = n; i != 0; --i) {
+      if (tape_->_key(static_cast<size_t>(items[i - 1])) == key) {
+        return static_cast<size_t>(items[i - 1]) + 2;
+      }
+    }
+    return 0;
+  }
+  // the members with the key are the last ones that are not greater than it
+  size_t lo = 0, hi = n;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (tape::_key_less(key, tape_->_key(static_cast<size_t>(items[mid])))) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  return lo != 0 && tape_->_key(static_cast<size_t>(items[lo - 1])) == key ? static_cast<size_t>(items[lo - 1]) + 2 : 0;
+}
+
+inline tape_value tape_value::get(const std::string &key) const {
+  PICOJSON_ASSERT(is<object>());
+  return tape_value(tape_, _find(key));
+}
+
+inline bool tape_value::contains(const size_t idx) const {
+  return is<array>() && idx < size();
+}
+
+inline bool tape_value::contains(const std::string &key) const {
+  return is<object>() && _find(key) != 0;
+}
+
+inline value tape_value::to_value() const {
+  switch (_type()) {
+  case 't':
+  case 'f':
+    return value(get<bool>());
+#ifdef PICOJSON_USE_INT64
+  case 'l':
+    return value(get<int64_t>());
+#endif
+  case 'd':
+    return value(get<double>());
+  case '"': {
+    string_view s = get_string_view();
+    return value(s.data(), s.size());
+  }
+  case '[': {
+    value v(array_type, false);
+    array &a = v.get<array>();
+    a.reserve(size());
+    for (const_iterator i = begin(); i != end(); ++i) {
+      a.push_back(value());
+      value e = (*i).to_value();
+      a.back().swap(e);
+    }
+    return v;
+  }
+  case '{': {
+    value v(object_type, false);
+    object &o = v.get<object>();
+    for (const_iterator i = begin(); i != end(); ++i) {
+      value e = (*i).to_value();
+      o[i.key().str()].swap(e);
+    }
+    return v;
+  }
+  default:
+    return value();
+  }
+}
+
+inline const char *parse(tape &out, const char *first, const char *last, std::string *err) {
+  return out.parse(first, last, err);
+}
+
+inline std::string parse(tape &out, const std::string &s) {
   std::string err;
-  parse(out, std::istreambuf_iterator<char>(is.rdbuf()), std::istreambuf_iterator<char>(), &err);
+  out.parse(s.data(), s.data() + s.size(), &err);
   return err;
 }
 
@@ -1155,7 +6080,8 @@ inline bool operator==(const value &x, const value &y) {
   return y.is<type>() && x.get<type>() == y.get<type>()
   PICOJSON_CMP(bool);
   PICOJSON_CMP(double);
-  PICOJSON_CMP(std::string);
+  if (x.is<std::string>())
+    return y.is<std::string>() && x.get_string_view() == y.get_string_view();
   PICOJSON_CMP(array);
   PICOJSON_CMP(object);
 #undef PICOJSON_CMP
@@ -1190,7 +6116,8 @@ inline std::istream &operator>>(std::istream &is, picojson::value &x) {
 }
 
 inline std::ostream &operator<<(std::ostream &os, const picojson::value &x) {
-  x.serialize(std::ostream_iterator<char>(os));
+  picojson::ostream_sink out(os);
+  x.serialize_to(out);
   return os;
 }
 #ifdef _MSC_VER
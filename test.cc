@@ -25,6 +25,12 @@
  * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
  * POSSIBILITY OF SUCH DAMAGE.
  */
+// std::map, the default PICOJSON_OBJECT_MAP, serializes the members of an object sorted by key; hash_map and flat_map keep
+// them in insertion order
+#ifndef PICOJSON_OBJECT_MAP
+#define SORTED_MEMBERS 1
+#endif
+
 #include "picojson.h"
 #include "picotest/picotest.h"
 
@@ -41,6 +47,27 @@ using namespace std;
 #include <float.h>
 #include <limits.h>
 
+#if PICOJSON_USE_THREADS
+struct ndjson_lines {
+  std::vector<size_t> lines;
+  std::vector<std::string> values;
+  void operator()(size_t line, picojson::value &v, const std::string &err) {
+    lines.push_back(line);
+    values.push_back(err.empty() ? v.serialize() : err);
+  }
+};
+
+struct ndjson_throw_at {
+  size_t line, calls;
+  void operator()(size_t l, picojson::value &, const std::string &) {
+    ++calls;
+    if (l == line) {
+      throw std::runtime_error("stop");
+    }
+  }
+};
+#endif
+
 int main(void)
 {
 #if PICOJSON_USE_LOCALE
@@ -57,6 +84,20 @@ int main(void)
   TEST( (string("hello")), "\"hello\"");
   TEST( ("hello"), "\"hello\"");
   TEST( ("hello", 4), "\"hell\"");
+  TEST( (0.1), "0.1");
+  TEST( (-0.0), "-0");
+  TEST( (1e20), "1e+20");
+  TEST( (1e16), "10000000000000000");
+  TEST( (1.5e-7), "1.5e-07");
+  TEST( (0.000649), "0.000649");
+  TEST( (8.429e-16), "8.429e-16");
+  TEST( (123456789012.0), "123456789012");
+  TEST( (-2.5), "-2.5");
+  TEST( (DBL_MAX), "1.7976931348623157e+308");
+  TEST( (5e-324), "5e-324");
+  TEST( (1e23), "1e+23");
+  TEST( (DBL_MIN), "2.2250738585072014e-308");
+  TEST( (5e-310), "5e-310");
 
   {
     double a = 1;
@@ -159,7 +200,15 @@ int main(void)
   	picojson::value &v2 = v1.get<picojson::object>()["1919"];
   	v2.set<picojson::object>(picojson::object());
   	v2.get<picojson::object>()["893"] = picojson::value(810.0);
+#ifdef SORTED_MEMBERS
     is(v1.serialize(), string("{\"114\":\"514\",\"1919\":{\"893\":810},\"364\":[334]}"), "modification succeed");
+#else
+    string expected_json("{\"114\":\"514\",\"1919\":{\"893\":810},\"364\":[334]}"), json = v1.serialize();
+    picojson::value expected, reparsed;
+    picojson::parse(expected, expected_json);
+    _ok(json.size() == expected_json.size() && picojson::parse(reparsed, json).empty() && reparsed == expected,
+        "modification succeed");
+#endif
   }
 
 #define TEST(json, msg) do {				\
@@ -173,7 +222,168 @@ int main(void)
   TEST("\n\bbell", "2 near: bell");
   TEST("\"abc\nd\"", "1 near: ");
 #undef TEST
-  
+
+  // the contiguous input engine should report errors exactly like the generic one
+#define TEST(json) do {							\
+    picojson::value v1, v2;						\
+    const std::string s(json);						\
+    std::istringstream iss(s);					\
+    string err1 = picojson::parse(v1, s), err2;			\
+    picojson::parse(v2, std::istreambuf_iterator<char>(iss),		\
+                    std::istreambuf_iterator<char>(), &err2);		\
+    _ok(!err1.empty(), #json " should fail");				\
+    is(err1, err2, #json " error message");				\
+  } while (0)
+  TEST("[1,\n2,\n  3 x]");
+  TEST("{\"a\":\n\"\\\nb\"}");
+  TEST("[\"\\ud800\\u\n\"]");
+  TEST("\n\n nul\nl");
+  TEST("[1, 2,\n\n");
+#undef TEST
+
+  {
+    // runs of whitespace shorter and longer than the 16 and 32-byte blocks, starting at every alignment, next to each kind of
+    // token
+    static const size_t lens[] = {1, 2, 15, 16, 17, 31, 32, 33, 47, 48, 63, 64, 65, 100};
+    picojson::value expected;
+    picojson::parse(expected, "[1,{\"a\":true},\"b\",null]");
+    size_t parsed = 0, errors = 0;
+    for (size_t align = 0; align != 33; ++align) {
+      for (size_t i = 0; i != sizeof(lens) / sizeof(lens[0]); ++i) {
+        std::string ws;
+        for (size_t j = 0; j != lens[i]; ++j)
+          ws.push_back(" \t\n\r"[(align + j) % 4]);
+        std::string json = std::string(align, ' ') + "[" + ws + "1" + ws + "," + ws + "{" + ws + "\"a\"" + ws + ":" + ws + "true" +
+                           ws + "}" + ws + "," + ws + "\"b\"" + ws + "," + ws + "null" + ws + "]" + ws;
+        picojson::value v;
+        if (picojson::parse(v, json).empty() && v == expected)
+          ++parsed;
+        json.replace(json.rfind(']'), 1, "x");
+        std::istringstream iss(json);
+        std::string err1 = picojson::parse(v, json), err2;
+        picojson::parse(v, std::istreambuf_iterator<char>(iss), std::istreambuf_iterator<char>(), &err2);
+        if (!err1.empty() && err1 == err2)
+          ++errors;
+      }
+    }
+    _ok(parsed == 33 * sizeof(lens) / sizeof(lens[0]), "long runs of whitespace");
+    _ok(errors == 33 * sizeof(lens) / sizeof(lens[0]), "line numbers after long runs of whitespace");
+  }
+
+  {
+    // strings around the block boundaries of the SIMD scanner
+    bool ok = true;
+    const char *specials[] = {"\\n", "\\\"", "\\u00e9", "\x7f", "\xc3\xa9", "\x1f"};
+    for (size_t len = 0; len < 70 && ok; ++len) {
+      for (size_t si = 0; si < sizeof(specials) / sizeof(specials[0]) && ok; ++si) {
+        std::string json = "\"" + std::string(len, 'a') + specials[si] + std::string(len % 7, 'b') + "\"";
+        picojson::value v1, v2;
+        std::istringstream iss(json);
+        string err1 = picojson::parse(v1, json), err2;
+        picojson::parse(v2, std::istreambuf_iterator<char>(iss), std::istreambuf_iterator<char>(), &err2);
+        ok = err1 == err2 && (!err1.empty() || v1.get<std::string>() == v2.get<std::string>());
+      }
+    }
+    _ok(ok, "strings are parsed identically by the contiguous and generic input");
+  }
+
+  _ok(picojson::_is_contiguous<const char *>::value && picojson::_is_contiguous<char *>::value &&
+          picojson::_is_contiguous<std::string::const_iterator>::value && picojson::_is_contiguous<std::string::iterator>::value &&
+          picojson::_is_contiguous<std::vector<char>::const_iterator>::value &&
+          picojson::_is_contiguous<std::vector<char>::iterator>::value &&
+          !picojson::_is_contiguous<std::istreambuf_iterator<char> >::value && !picojson::_is_contiguous<const int *>::value,
+      "the iterators over contiguous chars are recognized");
+
+  {
+    // streams are read in chunks, and the chars after each value are left in the stream
+    const char *s = "1 [2]{\"a\":\n\"\\u00e9\"}\"b\"\n[3,\n x] 4\n5";
+    std::string values;
+    std::istringstream iss(s);
+    FILE *fp = tmpfile();
+    fputs(s, fp);
+    rewind(fp);
+    for (int i = 0; i < 6; ++i) {
+      picojson::value v1, v2;
+      std::string err1 = (iss >> v1) ? "" : picojson::get_last_error(), err2 = picojson::parse(v2, fp);
+      values += (err1.empty() ? v1.serialize() : err1) + ",";
+      iss.clear();
+      _ok(v1 == v2 && err1 == err2, "parse from FILE");
+    }
+    _ok(values == "1,[2],{\"a\":\"\u00e9\"},\"b\",syntax error at line 3 near: x] 4,5,", "operator>> reads one value at a time");
+    fclose(fp);
+#if PICOJSON_USE_POSIX
+    fp = tmpfile();
+    fputs("[1] 2", fp);
+    fflush(fp);
+    lseek(fileno(fp), 0, SEEK_SET);
+    picojson::value v;
+    _ok(picojson::parse_fd(v, fileno(fp)).empty() && v.serialize() == "[1]" && lseek(fileno(fp), 0, SEEK_CUR) == 3, "parse_fd");
+    fclose(fp);
+    // a pipe cannot be moved back: a FILE * is read by lines, and the chars that were read after the value are returned
+    int fds[2];
+    if (pipe(fds) == 0) {
+      const char in[] = "[1]\n[2] [3]\n";
+      _ok(write(fds[1], in, sizeof(in) - 1) == static_cast<ssize_t>(sizeof(in) - 1), "write to pipe");
+      close(fds[1]);
+      fp = fdopen(fds[0], "r");
+      picojson::value v1, v2, v3;
+      std::string rest1, rest2, err1 = picojson::parse(v1, fp, &rest1), err2 = picojson::parse(v2, fp, &rest2);
+      _ok(err1.empty() && v1.serialize() == "[1]" && rest1 == "\n" && err2.empty() && v2.serialize() == "[2]" &&
+              rest2 == " [3]\n" && picojson::parse(v3, rest2).empty() && v3.serialize() == "[3]",
+          "parse from a pipe");
+      fclose(fp);
+    }
+    if (pipe(fds) == 0) {
+      const char in[] = "[1]\n[2]\n";
+      _ok(write(fds[1], in, sizeof(in) - 1) == static_cast<ssize_t>(sizeof(in) - 1), "write to pipe");
+      close(fds[1]);
+      std::string rest;
+      _ok(picojson::parse_fd(v, fds[0], &rest).empty() && v.serialize() == "[1]" && rest == "\n[2]\n", "parse_fd from a pipe");
+      close(fds[0]);
+    }
+#endif
+  }
+#if PICOJSON_USE_POSIX
+  {
+    char path[] = "/tmp/picojson-test-XXXXXX";
+    int fd = mkstemp(path);
+    const char json[] = "{\"a\":[1,\"b\"]}";
+    picojson::value v;
+    std::string err;
+    _ok(fd != -1 && write(fd, json, sizeof(json) - 1) == static_cast<ssize_t>(sizeof(json) - 1) && picojson::parse_file(v, path, &err) && err.empty() &&
+            v.serialize() == json,
+        "parse_file");
+    close(fd);
+    unlink(path);
+    _ok(!picojson::parse_file(v, path, &err) && err.find("failed to open /tmp/picojson-test-") == 0, "parse_file error");
+    _ok(!picojson::parse_file(v, "/dev/null", &err) && err == "syntax error at line 1 near: ", "parse_file reads what cannot be mapped");
+  }
+  {
+    // the pages of a large file are released as it is parsed
+    std::string json = "{\"a\":[", item = "{\"s\":\"" + std::string(1000, 'a') + "\",\"n\":[1.5,{\"b\":null}]}";
+    for (int i = 0; json.size() < 9 * 1024 * 1024; ++i) {
+      json += i != 0 ? ",\n" : "";
+      json += item;
+    }
+    json += "]}";
+    bool same = true;
+    for (int i = 0; i != 2; ++i) {
+      if (i == 1) {
+        json.insert(json.rfind(",\n") + 2, "x");
+      }
+      char path[] = "/tmp/picojson-test-XXXXXX";
+      int fd = mkstemp(path);
+      picojson::value expected, v;
+      std::string expected_err = picojson::parse(expected, json), err;
+      same = same && fd != -1 && write(fd, json.data(), json.size()) == static_cast<ssize_t>(json.size()) &&
+             picojson::parse_file(v, path, &err) == (i == 0) && err == expected_err && (i == 1 || v == expected);
+      close(fd);
+      unlink(path);
+    }
+    _ok(same, "parse_file of a large file");
+  }
+#endif
+
   {
     picojson::value v1, v2;
     const char *s;
@@ -226,7 +436,42 @@ int main(void)
 
   _ok(picojson::value(3.0).serialize() == "3",
      "integral number should be serialized as a integer");
-  
+
+#define TEST(json) do {						\
+    picojson::value v;						\
+    string err = picojson::parse(v, json);			\
+    _ok(err.empty(), json " no error");				\
+    _ok(v.is<double>() && v.get<double>() == strtod(json, NULL),	\
+	json " same as strtod");				\
+  } while (0)
+  TEST("0.1");
+  TEST("-0.30000000000000004");
+  TEST("37.7749295");
+  TEST("-122.4194155");
+  TEST("9007199254740993");
+  TEST("123456789012345678901234567890");
+  TEST("2.2250738585072011e-308");
+  TEST("4.9e-324");
+  TEST("1e-400");
+  TEST("1.7976931348623157e308");
+  TEST("0.000000000000000000000000000001e30");
+  TEST("1E+22");
+  TEST("1e23");
+#undef TEST
+
+#define TEST(json) do {						\
+    picojson::value v;						\
+    string err = picojson::parse(v, json);			\
+    _ok(!err.empty(), json " should fail");			\
+  } while (0)
+  TEST("-");
+  TEST("1e");
+  TEST("1e+");
+  TEST("1.5.3");
+  TEST("1-2");
+  TEST("--1");
+#undef TEST
+
   {
     const char* s = "{ \"a\": [1,2], \"d\": 2 }";
     picojson::null_parse_context ctx;
@@ -255,6 +500,22 @@ int main(void)
     _ok(v2.is<picojson::object>(), "swap (object)");
   }
   
+  {
+#if PICOJSON_USE_NAN_BOXING
+    _ok(sizeof(picojson::value) == 8, "value is 8 bytes");
+#endif
+    picojson::value v(true);
+    v.get<bool>() = false;
+    _ok(v.is<bool>() && !v.get<bool>(), "modify bool through get<bool>()");
+    v = picojson::value(-0.0);
+    v.get<double>() = 1.5;
+    _ok(v.is<double>() && v.get<double>() == 1.5, "modify number through get<double>()");
+    picojson::array a(3);
+    a[1] = picojson::value("abc");
+    a[2] = picojson::value(picojson::object());
+    _ok(a[0].is<picojson::null>() && a[1].get<std::string>() == "abc" && a[2].is<picojson::object>(), "values in an array");
+  }
+
   {
     picojson::value v;
     const char *s = "{ \"a\": 1, \"b\": [ 2, { \"b1\": \"abc\" } ], \"c\": {}, \"d\": [] }";
@@ -306,6 +567,24 @@ int main(void)
     _ok(v1.is<double>(), "underflowing int is double");
     _ok(v1.get<double>() + 9.22337203685478e+18 < 65536, "double value is somewhat correct");
   }
+  {
+    // on both sides of the 48-bit payload of a NaN, and of the int64 range
+    std::string json = "[140737488355327,140737488355328,-140737488355328,-140737488355329,0,-1,9223372036854775807,"
+                       "-9223372036854775808]";
+    int64_t expected[] = {140737488355327LL, 140737488355328LL, -140737488355328LL, -140737488355329LL, 0, -1,
+                          9223372036854775807LL, -9223372036854775807LL - 1};
+    picojson::value v, copy;
+    _ok(picojson::parse(v, json).empty() && v.serialize() == json, "int64 round trip");
+    copy = v;
+    bool same = true;
+    const picojson::array &a = copy.get<picojson::array>();
+    for (size_t i = 0; i != a.size(); ++i)
+      same = same && a[i].is<int64_t>() && a[i].evaluate_as_boolean() == (expected[i] != 0) && a[i].get<int64_t>() == expected[i];
+    _ok(same, "int64 values are read back");
+    v.get(5).get<int64_t>() = 140737488355328LL;
+    v.get(0).get<int64_t>() += 1;
+    _ok(v.get(5).to_str() == "140737488355328" && v.get(0).to_str() == "140737488355328", "int64 modified through get<int64_t>()");
+  }
 #endif
 
   {
@@ -364,6 +643,689 @@ int main(void)
     _ok(v.get(0).is<picojson::null>(), "that contains null");
   }
 
+  {
+    picojson::value v;
+    _ok(picojson::parse(v, "[\"US\",\"12345678\",\"123456789\",\"a\\nb\",\"\"]").empty(), "parse short strings");
+    picojson::array &a = v.get<picojson::array>();
+    _ok(a[0].get_string_view() == "US" && a[1].get_string_view() == "12345678" && a[2].get_string_view() == "123456789",
+        "get_string_view");
+    _ok(a[3].get_string_view() == "a\nb" && a[4].get_string_view().empty(), "get_string_view (escaped, empty)");
+    picojson::value copy(a[1]);
+    a[1].get<std::string>() += "9";
+    _ok(a[1].get<std::string>() == "123456789" && a[1] == a[2], "modify string through get<std::string>()");
+    _ok(copy.get_string_view() == "12345678" && copy != a[1], "copy is not modified");
+    _ok(picojson::value("JP") == picojson::value(std::string("JP")), "compare strings");
+    const picojson::value c("JP");
+    const char *chars = c.get_string_view().data();
+    _ok(c.get<std::string>() == "JP" && c.get_string_view().data() == chars, "const get<std::string>() does not modify the value");
+    _ok(v.serialize() == "[\"US\",\"123456789\",\"123456789\",\"a\\nb\",\"\"]", "serialize strings");
+    a[0].set<std::string>("abc");
+    _ok(a[0].get_string_view() == "abc" && a[0].to_str() == "abc", "set string");
+  }
+
+  {
+    std::string s = "{\"k\":[\"a string that does not fit in SSO\",\"esc\\taped\",\"x\"]}";
+    std::string expected = s;
+    picojson::value v;
+    _ok(picojson::parse_view(v, s).empty(), "parse_view");
+    picojson::string_view sv = v.get("k").get(0).get_string_view();
+    _ok(sv == "a string that does not fit in SSO", "parse_view string");
+#if !PICOJSON_USE_NAN_BOXING
+    _ok(sv.data() > s.data() && sv.data() < s.data() + s.size(), "string refers to the input");
+#endif
+    _ok(v.get("k").get(1).get_string_view() == "esc\taped" && v.get("k").get(2).get_string_view() == "x",
+        "parse_view escaped and short strings");
+    _ok(v.serialize() == expected, "serialize views");
+    picojson::value copy(v), undetached_copy(v);
+    copy.detach();
+    s.replace(s.find("a string"), 8, "modified");
+    _ok(copy.serialize() == expected, "detached copy does not refer to the input");
+    _ok(undetached_copy.serialize() == expected, "copy of views owns its chars");
+    std::string chars = "a string that does not fit in SSO";
+    picojson::value owned((picojson::string_view(chars)));
+    chars[0] = 'A';
+    _ok(owned.get_string_view() == "a string that does not fit in SSO", "value(string_view) copies the chars");
+    picojson::value w(picojson::string_view(s.data() + s.find("modified"), 8));
+    w.get<std::string>() += "!";
+    _ok(w.get_string_view() == "modified!", "modify view through get<std::string>()");
+    picojson::document doc;
+    _ok(picojson::parse_view(doc, s).empty() && doc.root().get("k").get(0).get_string_view() == "modified that does not fit in SSO",
+        "parse_view into document");
+  }
+
+  {
+    std::string s = "{\"a\\tb\":[\"esc\\\"aped\\n\",\"\\u00e9\\ud83d\\ude00\\/x\",\"a string that does not fit in SSO\",1]}";
+    std::vector<char> buf(s.begin(), s.end());
+    picojson::value v, expected;
+    std::string err;
+    picojson::parse(expected, s);
+    char *end = picojson::parse_insitu(v, &buf[0], &buf[0] + buf.size(), &err);
+    _ok(err.empty() && end == &buf[0] + buf.size(), "parse_insitu");
+    _ok(v == expected, "parse_insitu decodes the same as parse");
+#if !PICOJSON_USE_NAN_BOXING
+    picojson::string_view sv = v.get("a\tb").get(0).get_string_view();
+    _ok(sv.data() > &buf[0] && sv.data() < &buf[0] + buf.size(), "escaped string refers to the buffer");
+#endif
+    buf.assign(s.begin(), s.end());
+    buf[buf.size() - 4] = 'x';
+    picojson::parse_insitu(v, &buf[0], &buf[0] + buf.size(), &err);
+    _ok(!err.empty(), "parse_insitu error");
+  }
+
+  {
+    std::string chars;
+    for (int c = 1; c < 0x80; ++c) {
+      chars.push_back(static_cast<char>(c));
+    }
+    picojson::object o;
+    o["s\x1f/"] = picojson::value(chars);
+    o["a"] = picojson::value(picojson::array(3, picojson::value(1.5)));
+    picojson::value v(o);
+    std::string compact = v.serialize(), pretty = v.serialize(true), via_iter, via_sink;
+    _ok(compact.find("\"\\u0001\\u0002") != std::string::npos && compact.find("\\u001f !\\\"#") != std::string::npos &&
+            compact.find(".\\/0") != std::string::npos && compact.find("[\\\\]") != std::string::npos &&
+            compact.find("}~\\u007f\"") != std::string::npos &&
+#ifdef SORTED_MEMBERS
+            compact.find("{\"a\":[1.5,1.5,1.5],\"s\\u001f\\/\":") == 0,
+#else
+            compact.find("\"a\":[1.5,1.5,1.5]") != std::string::npos && compact.find("\"s\\u001f\\/\":\"") != std::string::npos,
+#endif
+        "serialize escapes");
+    v.serialize(std::back_inserter(via_iter), true);
+    v.serialize_to(via_sink, true);
+    _ok(via_iter == pretty && via_sink == pretty, "serialize_to");
+    _ok(v.serialized_size() == compact.size() && v.serialized_size(true) == pretty.size(), "serialized_size");
+    std::ostringstream os;
+    os << v;
+    _ok(os.str() == compact, "operator<< writes through ostream_sink");
+  }
+  {
+    std::string json = "[\"abcdefghijklmnopqrstuvwxyz0123456789\",\"abcdefghijklmnopqrstuvwxyz/0123456789\",\"\\u007f\",\"\\n\",\"a\"]";
+    picojson::value v;
+    std::string err = picojson::parse(v, json);
+    _ok(err.empty() && v.serialize() == "[\"abcdefghijklmnopqrstuvwxyz0123456789\",\"abcdefghijklmnopqrstuvwxyz\\/0123456789\","
+                                       "\"\\u007f\",\"\\n\",\"a\"]",
+        "serialize parsed strings");
+    picojson::value copy = v;
+    _ok(copy.serialize() == v.serialize(), "serialize copy of parsed strings");
+    v.get<picojson::array>()[0].get<std::string>() += "/\"";
+    v.get<picojson::array>()[4].get<std::string>()[0] = '\x7f';
+    _ok(v.serialize() == "[\"abcdefghijklmnopqrstuvwxyz0123456789\\/\\\"\",\"abcdefghijklmnopqrstuvwxyz\\/0123456789\","
+                         "\"\\u007f\",\"\\n\",\"\\u007f\"]",
+        "serialize parsed strings after modification");
+    std::vector<char> buf(json.begin(), json.end());
+    picojson::parse_insitu(v, &buf[0], &buf[0] + buf.size(), &err);
+    _ok(err.empty() && v.serialize() == copy.serialize(), "serialize strings parsed in place");
+  }
+  {
+    // whether a string has to be escaped is found while scanning for its end, in the SIMD blocks and in the tail
+    bool same = true;
+    for (size_t len = 1; len != 70; ++len) {
+      for (size_t pos = 0; pos != len; ++pos) {
+        for (int i = 0; i != 2; ++i) {
+          std::string str(len, 'a');
+          str[pos] = i == 0 ? '/' : '\x7f';
+          std::string json = "[\"" + str + "\"]", err;
+          picojson::value v;
+          err = picojson::parse(v, json);
+          std::vector<char> buf(json.begin(), json.end());
+          picojson::value insitu;
+          picojson::parse_insitu(insitu, &buf[0], &buf[0] + buf.size(), &err);
+          std::string expected = picojson::value(picojson::array(1, picojson::value(str))).serialize();
+          same = same && err.empty() && v.serialize() == expected && insitu.serialize() == expected;
+        }
+      }
+    }
+    _ok(same, "serialize parsed strings with '/' or DEL at any position");
+  }
+  {
+    const char *json = "{\"a\":[1.5,true,null,\"x/\\n\",[],{}],\"b\":{\"c\":[[2]],\"d\":\"e\"},\"f\":[3,{\"g\":false}]}";
+    picojson::value v;
+    picojson::parse(v, json, json + strlen(json));
+    for (int prettify = 0; prettify != 2; ++prettify) {
+      std::string out;
+      picojson::writer<std::string> w(out, prettify != 0);
+      w.begin_object();
+      w.key("a");
+      w.begin_array();
+      w.value(1.5);
+      w.value(true);
+      w.value(picojson::null());
+      w.value(std::string("x/\n"));
+      w.begin_array();
+      w.end_array();
+      w.begin_object();
+      w.end_object();
+      w.end_array();
+      w.key(std::string("b"));
+      w.begin_object();
+      w.key("c");
+      w.begin_array();
+      w.begin_array();
+      w.value(2.0);
+      w.end_array();
+      w.end_array();
+      w.key("d");
+      w.value("e");
+      w.end_object();
+      w.key("f");
+      w.value(v.get("f"));
+      w.end_object();
+      _ok(out == v.serialize(prettify != 0), prettify ? "writer prettify" : "writer");
+    }
+    std::string out;
+    picojson::writer<std::string> w(out);
+    w.value(v);
+    _ok(out == v.serialize(), "writer value tree at top level");
+#ifndef NDEBUG
+    picojson::writer<std::string> w2(out);
+    bool thrown = false;
+    try {
+      w2.begin_array();
+      w2.end_object();
+    } catch (std::runtime_error &) {
+      thrown = true;
+    }
+    _ok(thrown, "writer checks nesting");
+#endif
+  }
+#if PICOJSON_USE_POSIX
+  {
+    picojson::array a;
+    for (int i = 0; i < 200; ++i) {
+      a.push_back(picojson::value(std::string(i * 7, 'a') + (i % 3 == 0 ? "/\n" : "") + std::string(i, 'b')));
+      a.push_back(picojson::value(i * 1.5));
+    }
+    picojson::value v(a);
+    for (int ref = 0; ref != 2; ++ref) {
+      FILE *fp = tmpfile();
+      bool good;
+      {
+        picojson::fd_sink out(fileno(fp), 100, ref ? 50 : 0);
+        v.serialize_to(out, true);
+        good = out.flush();
+      }
+      std::string read;
+      rewind(fp);
+      for (int ch; (ch = fgetc(fp)) != EOF;) {
+        read.push_back(static_cast<char>(ch));
+      }
+      fclose(fp);
+      _ok(good && read == v.serialize(true), ref ? "fd_sink with writev references" : "fd_sink");
+    }
+    {
+      // numbers and escape sequences are formatted on the stack, and must be copied even if they are long enough to be referred to
+      picojson::array nums;
+      for (int i = 0; i < 50; ++i) {
+        nums.push_back(picojson::value(0.1234567890123456 + i));
+        nums.push_back(picojson::value(std::string(i % 5, 'x') + "\x01\"/\x7f"));
+#ifdef PICOJSON_USE_INT64
+        nums.push_back(picojson::value(static_cast<int64_t>(-1234567890123456789LL + i)));
+#endif
+      }
+      picojson::value n(nums);
+      FILE *fp = tmpfile();
+      bool good;
+      {
+        picojson::fd_sink out(fileno(fp), 4096, 2);
+        n.serialize_to(out);
+        good = out.flush();
+      }
+      std::string read;
+      rewind(fp);
+      for (int ch; (ch = fgetc(fp)) != EOF;) {
+        read.push_back(static_cast<char>(ch));
+      }
+      fclose(fp);
+      _ok(good && read == n.serialize(), "fd_sink with a small ref_size copies numbers and escapes");
+    }
+    picojson::fd_sink out(-1, 100);
+    v.serialize_to(out);
+    _ok(!out.flush() && !out.good(), "fd_sink write error");
+  }
+#endif
+#if PICOJSON_USE_THREADS
+  {
+    std::string s = "[1]\n\n{\"a\":2}\r\n[1,]\n  \n\"x\" 3\n", expected;
+    for (int i = 0; i < 20000; ++i) {
+      s += "[\"abcdefghijklmnopqrstuvwxyz\",1]\n";
+    }
+    s += "4";
+    picojson::ndjson_options opts;
+    opts.threads = 4;
+    ndjson_lines ordered;
+    _ok(picojson::parse_ndjson(s, ordered, opts) == 2, "parse_ndjson error count");
+    _ok(ordered.lines.size() == 20005 && ordered.lines[1] == 3 && ordered.lines[4] == 7 && ordered.lines.back() == 20007,
+        "parse_ndjson line numbers");
+    _ok(ordered.values[0] == "[1]" && ordered.values[1] == "{\"a\":2}" && ordered.values[2] == "syntax error at line 4 near: ]" &&
+            ordered.values[3] == "syntax error at line 6 near: 3" && ordered.values.back() == "4",
+        "parse_ndjson values and errors");
+    opts.ordered = false;
+    ndjson_lines unordered;
+    picojson::parse_ndjson(s, unordered, opts);
+    std::sort(unordered.lines.begin(), unordered.lines.end());
+    _ok(unordered.lines == ordered.lines, "parse_ndjson unordered");
+    std::istringstream iss(s);
+    ndjson_lines streamed;
+    picojson::parse_ndjson(iss, streamed);
+    _ok(streamed.lines == ordered.lines && streamed.values == ordered.values, "parse_ndjson istream");
+    // the callback runs without the lock, and what it throws stops the other threads
+    for (int i = 0; i != 2; ++i) {
+      opts.ordered = i == 0;
+      ndjson_throw_at cb = {10000, 0};
+      bool thrown = false;
+      try {
+        picojson::parse_ndjson(s, cb, opts);
+      } catch (const std::runtime_error &) {
+        thrown = true;
+      }
+      _ok(thrown && cb.calls < 20005, opts.ordered ? "parse_ndjson callback throws" : "parse_ndjson unordered callback throws");
+    }
+  }
+  {
+    std::string s = "[";
+    for (int i = 0; i < 20000; ++i) {
+      s += i != 0 ? ",\n" : "";
+      s += "{\"s\":\"],[\\\"{,\",\"a\":[1,{\"b\":null}]}";
+    }
+    s += "] ";
+    picojson::value expected, v;
+    std::string err;
+    picojson::parse(expected, s.begin(), s.end(), NULL);
+    const char *end = picojson::parse_parallel(v, s.data(), s.data() + s.size(), &err, 4);
+    _ok(end == s.data() + s.size() - 1 && err.empty() && v == expected, "parse_parallel");
+    s.replace(s.find(",\n", s.size() / 2), 1, " ");
+    const char *pos = picojson::parse(expected, s.data(), s.data() + s.size(), &err);
+    std::string perr;
+    end = picojson::parse_parallel(v, s.data(), s.data() + s.size(), &perr, 4);
+    _ok(end == pos && perr == err && err.find("at line 10002 near") != std::string::npos, "parse_parallel error");
+    _ok(picojson::parse_parallel(v, "{\"a\":[1,2]}", 4).empty() && v.get("a").get<picojson::array>().size() == 2,
+        "parse_parallel object");
+  }
+  {
+    picojson::value v;
+    std::string s = "{\"a\":[[],{}],\"b\":[";
+    for (int i = 0; i < 1000; ++i) {
+      char buf[64];
+      sprintf(buf, "%s{\"k%d\":[%d,\"\\u0001/\"],\"e\":{}}", i != 0 ? "," : "", i, i);
+      s += buf;
+    }
+    s += "],\"c\":{\"d\":{\"e\":[1,2,3,4,5,6,7,8,9,10]}}}";
+    picojson::parse(v, s);
+    _ok(v.serialize_parallel(false, 4) == v.serialize(), "serialize_parallel");
+    _ok(v.serialize_parallel(true, 4) == v.serialize(true), "serialize_parallel prettify");
+    std::string out;
+    v.get("b").serialize_parallel(std::back_inserter(out), true, 3);
+    _ok(out == v.get("b").serialize(true), "serialize_parallel to iterator");
+  }
+#endif
+  {
+    std::string s = "{\"a\":[1.5,-2e3,true,false,null],\"b\\u00e9\":\"x\\ud83d\\ude00y\",\"c\":{\"d\":[[]],\"e\":{}}} [2]";
+    picojson::value expected, v;
+    picojson::parse(expected, s.begin(), s.end(), NULL);
+    picojson::incremental_parser p(&v);
+    const char *q = s.data(), *end = s.data() + s.size();
+    bool consumed = true;
+    for (; q != end && !p.done(); ++q) {
+      consumed = consumed && p.feed(q, q + 1) == q + 1;
+    }
+    _ok(consumed && p.finish() && v == expected, "incremental_parser feed one byte at a time");
+    _ok(std::string(q, end) == " [2]", "incremental_parser stops after the value");
+    p.reset(&v);
+    _ok(p.feed(q, end) == end && p.done() && p.finish() && v.serialize() == "[2]", "incremental_parser reset");
+    p.reset(&v);
+    const char *num = "-12e3";
+    _ok(p.feed(num, num + 4) == num + 4 && !p.done(), "incremental_parser number needs more input");
+    _ok(p.feed(num + 4, num + 5) == num + 5 && !p.done() && p.finish() && v.get<double>() == -12e3,
+        "incremental_parser number finish");
+  }
+  {
+    picojson::value v;
+    picojson::incremental_parser p(&v);
+    std::string s = "[1,\n{\"a\" 2}]";
+    _ok(p.feed(s.data(), s.data() + s.size()) == s.data() + 9 && !p.finish() && p.get_error() == "syntax error at line 2 near: 2}]",
+        "incremental_parser error");
+    p.reset(&v);
+    _ok(p.feed(s.data(), s.data() + 5) == s.data() + 5 && !p.finish() && p.get_error() == "syntax error at line 2 near: ",
+        "incremental_parser unexpected end");
+    p.reset(&v);
+    _ok(p.feed(s.data(), s.data() + 7) == s.data() + 7 && p.depth() == 2 && p.line() == 2 && p.position() == 7,
+        "incremental_parser position and depth");
+  }
+  {
+    // the errors, including those inside a token, must be found where parse() finds them wherever the input is split; the
+    // text after "near: " may be cut short at the end of the chunk, and feed() cannot point back into an earlier chunk
+    const char *inputs[] = {"[\"a\tb\"]", "[\"ab\x01\"]", "{\"k\x02\":1}", "[\"\\x\"]", "[\"\\u12g4\"]", "{\"\\q\":1}",
+                            "[1.2.3]", "[-]",        "[1e]",          "[tru]",      "[nul]",           "[1,\n\"a\x1f\"]"};
+    bool same = true;
+    for (size_t i = 0; i != sizeof(inputs) / sizeof(inputs[0]); ++i) {
+      std::string s = inputs[i], expected_err;
+      picojson::value expected, v;
+      picojson::parse(expected, s.data(), s.data() + s.size(), &expected_err);
+      size_t near = expected_err.find("near: ") + 6, error_pos = 0;
+      for (size_t split = 0; split <= s.size(); ++split) {
+        picojson::incremental_parser p(&v);
+        const char *end = p.feed(s.data(), s.data() + split);
+        if (end == s.data() + split && !p.done()) {
+          end = p.feed(s.data() + split, s.data() + s.size());
+        }
+        if (split == 0) {
+          error_pos = p.position();
+        }
+        const std::string &err = p.get_error();
+        same = same && !p.finish() && err.size() >= near && expected_err.compare(0, err.size(), err) == 0 &&
+               p.position() <= static_cast<size_t>(end - s.data()) && p.position() == error_pos;
+      }
+    }
+    _ok(same, "incremental_parser reports errors inside tokens like parse()");
+  }
+  {
+    typedef picojson::reader<std::string::const_iterator> reader;
+    std::string s = "{\"a\":[1,\"x\\ty\",null,{}],\"b\":{\"c\":[[true]],\"d\":2},\"e\":false} rest", tokens;
+    reader r(s.begin(), s.end());
+    int t;
+    while ((t = r.next()) != reader::end_of_value && t != reader::error) {
+      char buf[64];
+      switch (t) {
+      case reader::key:
+        tokens += r.get_string() + ":";
+        break;
+      case reader::number_value:
+        sprintf(buf, "%g,", r.get_number());
+        tokens += buf;
+        break;
+      case reader::string_value:
+        tokens += "'" + r.get_string() + "',";
+        break;
+      case reader::boolean_value:
+        tokens += r.get_bool() ? "true," : "false,";
+        break;
+      case reader::null_value:
+        tokens += "null,";
+        break;
+      default:
+        tokens += "[]{}"[t == reader::begin_array ? 0 : t == reader::end_array ? 1 : t == reader::begin_object ? 2 : 3];
+        break;
+      }
+    }
+    _ok(t == reader::end_of_value && tokens == "{a:[1,'x\ty',null,{}]b:{c:[[true,]]d:2,}e:false,}", "reader tokens");
+    _ok(r.cur() == s.begin() + s.find(" rest"), "reader stops after the value");
+    reader r2(s.begin(), s.end());
+    _ok(r2.next() == reader::begin_object && r2.next() == reader::key && r2.skip() && r2.next() == reader::key &&
+            r2.get_string_view() == "b" && r2.next() == reader::begin_object && r2.depth() == 2 && r2.skip() && r2.depth() == 1 &&
+            r2.next() == reader::key && r2.next() == reader::boolean_value && r2.next() == reader::end_object &&
+            r2.next() == reader::end_of_value,
+        "reader skip");
+    // skipped values are nested no deeper than parse() allows
+    bool same = true;
+    for (size_t depth = picojson::DEFAULT_MAX_DEPTHS; depth <= picojson::DEFAULT_MAX_DEPTHS + 1; ++depth) {
+      std::string deep = std::string(depth, '[') + std::string(depth, ']'), keyed = "{\"a\":" + deep.substr(1, depth * 2 - 2) + "}";
+      picojson::value v;
+      bool ok = picojson::parse(v, deep).empty();
+      reader r4(deep.begin(), deep.end()), r5(keyed.begin(), keyed.end());
+      same = same && (r4.next() == reader::begin_array && r4.next() == reader::begin_array && r4.skip()) == ok &&
+             (r5.next() == reader::begin_object && r5.next() == reader::key && r5.skip()) == ok;
+    }
+    _ok(same, "reader skip rejects deep nesting like parse");
+    std::string bad = "[1,{\"a\" 2}]";
+    reader r3(bad.begin(), bad.end());
+    while ((t = r3.next()) != reader::end_of_value && t != reader::error)
+      ;
+    _ok(t == reader::error && r3.get_error() == "syntax error at line 1 near: 2}]", "reader error");
+  }
+
+  {
+    std::string s = "{\"a\":[1,{\"b\":[\"]\",\"c\\\"[\",{}]}],\"d\":{\"e\":true},\"f\":\"g\"}";
+    std::string expected = s;
+    picojson::value v, lazy;
+    picojson::parse(v, s);
+    _ok(picojson::parse_lazy(lazy, s).empty(), "parse_lazy");
+    _ok(lazy.get("a").is<picojson::array>() && lazy.get("d").is<picojson::object>(), "parse_lazy types");
+    _ok(lazy.get("a").get(1).get("b").get(1).get<std::string>() == "c\"[", "parse_lazy nested access");
+    _ok(lazy == v && lazy.serialize() == expected, "parse_lazy has the same tree as parse");
+    picojson::value copy(lazy), unparsed;
+    copy.detach();
+    picojson::parse_lazy(unparsed, s);
+    picojson::value unparsed_copy(unparsed), member_copy(unparsed.get("d"));
+    s.replace(s.find("true"), 4, "null");
+    _ok(copy.serialize() == expected, "detached copy does not refer to the input");
+    _ok(unparsed_copy.serialize() == expected && member_copy.serialize() == "{\"e\":true}", "copy of unparsed values owns its chars");
+    std::string broken = "[1,{\"a\":tru},[2]]";
+    _ok(!picojson::parse_lazy(lazy, broken, true).empty(), "parse_lazy validates the input if asked");
+#if !PICOJSON_USE_NAN_BOXING
+    _ok(picojson::parse_lazy(lazy, broken).find("syntax error at line 1") == 0, "parse_lazy validates the input by default");
+    _ok(picojson::parse_lazy(lazy, broken, false).empty() && lazy.get(2).get(0).get<double>() == 2, "parse_lazy without validation");
+    const char *position = NULL;
+    std::string what;
+    try {
+      lazy.get(1).get("a");
+    } catch (picojson::lazy_parse_error &e) {
+      position = e.position;
+      what = e.what();
+    }
+    _ok(position == broken.data() + broken.find("},") && what == "syntax error at offset 8 of an unparsed object near: }",
+        "error in an unvalidated subtree is thrown on access");
+    picojson::parse_lazy(lazy, broken, false);
+    picojson::value copied(lazy.get(1)), copied_array(lazy.get(2));
+    broken.clear();
+    what.clear();
+    try {
+      copied.get("a");
+    } catch (picojson::lazy_parse_error &e) {
+      what = e.what();
+    }
+    _ok(copied.is<picojson::object>() && what == "syntax error at offset 8 of an unparsed object near: }" &&
+            copied_array.serialize() == "[2]",
+        "copying an unparsed value copies its text and parses it on access");
+#endif
+    // the subtrees are nested no deeper than parse() allows, even without validation
+    for (int i = 0; i != 2; ++i) {
+      size_t depth = i == 0 ? picojson::DEFAULT_MAX_DEPTHS : 80000;
+      std::string deep = "[1," + std::string(depth - 1, '[') + std::string(depth - 1, ']') + "]", err1, err2;
+      picojson::value v1, v2;
+      err1 = picojson::parse(v1, deep);
+      err2 = picojson::parse_lazy(v2, deep, false);
+      _ok(err1 == err2 && (i == 0 ? err1.empty() && v2.serialize() == deep : !err1.empty()),
+          i == 0 ? "parse_lazy accepts the maximum depth" : "parse_lazy rejects deep nesting like parse");
+    }
+  }
+
+  {
+    // long enough for the strings and the runs of backslashes to cross the 64-byte blocks of the indexer
+    std::string s = "{\"a\":[1,-2.5e3,\"a string that does not fit in one block of the indexer: \\\\\\\\\\\"\\u00e9\","
+                    "true,false,null,[],{}],\n \"b\" : {\"c\":\"d\"} }";
+    picojson::tape t;
+    picojson::value v;
+    _ok(picojson::parse(t, s).empty(), "parse into tape");
+    picojson::parse(v, s);
+    _ok(t.root().to_value() == v, "tape has the same tree as value");
+    picojson::tape_value a = t.root().get("a");
+    _ok(t.root().is<picojson::object>() && t.root().size() == 2 && a.is<picojson::array>() && a.size() == 8, "tape size");
+    _ok(a.get(0).get<double>() == 1 && a.get(1).get<double>() == -2500 && a.get(3).get<bool>() && a.get(5).is<picojson::null>(),
+        "tape scalars");
+    _ok(a.get(2).get<std::string>() == v.get("a").get(2).get<std::string>(), "tape string");
+    _ok(a.get(6).is<picojson::array>() && a.get(6).size() == 0 && a.get(7).is<picojson::object>() && a.get(7).size() == 0,
+        "tape empty containers");
+    _ok(t.root().get("b").get("c").get_string_view() == "d", "tape lookup by key");
+    _ok(t.root().get("x").is<picojson::null>() && a.get(8).is<picojson::null>() && !a.contains(8) && !t.root().contains("x"),
+        "tape missing elements");
+    std::string keys;
+    for (picojson::tape_value::const_iterator i = t.root().begin(); i != t.root().end(); ++i)
+      keys += i.key().str() + ((*i).is<picojson::array>() ? "[]" : "{}");
+    _ok(keys == "a[]b{}", "tape iteration");
+    _ok(!picojson::parse(t, "[1,\"a\" x]").empty() && !picojson::parse(t, "[truex]").empty() &&
+            !picojson::parse(t, "{\"a\":1,}").empty() && !picojson::parse(t, "[\"\\\"]").empty(),
+        "tape syntax errors");
+    _ok(picojson::parse(t, "[1,2]").empty() && t.root().size() == 2, "reparse tape");
+  }
+  {
+    // an object of more than 8 members is looked up through its sorted keys; a duplicate key resolves as in parse()
+    std::string s = "[{\"x\":1,\"y\":[2],\"x\":3},{";
+    for (int i = 19; i >= 0; --i) {
+      char member[32];
+      sprintf(member, "\"k%d\":[%d,{\"n\":%d}],", i, i, i);
+      s += member;
+    }
+    s += "\"k5\":\"last\",\"\":0}]";
+    picojson::tape t;
+    picojson::value v;
+    _ok(picojson::parse(t, s).empty() && picojson::parse(v, s).empty(), "parse objects with many and duplicate keys");
+    picojson::tape_value small = t.root().get(0), large = t.root().get(1);
+    bool same = small.get("x").get<double>() == 3 && small.get("y").get(0).get<double>() == 2 && large.size() == 22 &&
+                large.get("k5").get<std::string>() == "last" && large.get("").get<double>() == 0 && !large.contains("k20") &&
+                !large.contains("k") && t.root().to_value() == v;
+    for (int i = 0; i < 20; ++i) {
+      char key[16];
+      sprintf(key, "k%d", i);
+      same = same && large.contains(key) && large.get(key).to_value() == v.get(1).get(key);
+    }
+    picojson::tape_value::const_iterator first = large.begin();
+    _ok(same && first.key() == "k19" && (*first).get(1).get("n").get<double>() == 19, "tape lookup in large objects");
+  }
+
+  {
+    const char *json = "[{\"status\":\"unavailable\",\"msg\":\"\\u0064isk is almost full\"},"
+                       "\"a string that is too long for the pool\"]";
+    picojson::value expected, v1, v2;
+    picojson::parse(expected, json);
+#if PICOJSON_USE_NAN_BOXING
+    const size_t pooled = 0; // a value cannot refer to the chars of the pool
+#else
+    const size_t pooled = 2;
+#endif
+    picojson::value copy;
+    {
+      picojson::string_pool pool(32, 3);
+      std::string err;
+      picojson::parse(v1, json, json + strlen(json), pool, &err);
+      _ok(err.empty() && v1 == expected && pool.size() == pooled, "parse with string pool");
+      _ok(picojson::parse(v2, json, pool).empty() && v2 == expected && pool.size() == pooled, "string pool is shared between parses");
+#if !PICOJSON_USE_NAN_BOXING
+      _ok(v1.get(0).get("status").get_string_view().data() == v2.get(0).get("status").get_string_view().data() &&
+              v1.get(0).get("msg").get_string_view().data() == v2.get(0).get("msg").get_string_view().data(),
+          "pooled strings refer to the same chars");
+#endif
+      _ok(v1.get(1).get_string_view().data() != v2.get(1).get_string_view().data(), "long strings are not pooled");
+      _ok(picojson::parse(v2, "[\"info\",\"error message\",\"\"]", pool).empty() && pool.size() == (pooled != 0 ? 3 : 0) &&
+              v2.get(1).get<std::string>() == "error message" && v2.get(2).get<std::string>().empty(),
+          "string pool stops growing at its limit");
+      copy = v1;
+      copy.detach();
+    }
+    _ok(copy == expected, "detached copy does not refer to the pool");
+#if PICOJSON_USE_THREADS
+    std::string s;
+    for (int i = 0; i < 1000; ++i) {
+      s += i % 2 ? "{\"level\":\"warning\",\"n\":1}\n" : "{\"level\":\"info\",\"n\":2}\n";
+    }
+    picojson::string_pool pool;
+    picojson::ndjson_options opts;
+    opts.threads = 4;
+    opts.pool = &pool;
+    ndjson_lines lines;
+    _ok(picojson::parse_ndjson(s, lines, opts) == 0 && lines.lines.size() == 1000 && pool.size() == pooled &&
+            lines.values[1] == "{\"level\":\"warning\",\"n\":1}",
+        "parse_ndjson with string pool");
+    // the pool grows while the other threads look strings up in it
+    s.clear();
+    for (int i = 0; i < 20000; ++i) {
+      char buf[64];
+      sprintf(buf, "[\"s%d\",\"t%d\"]\n", (i * 7) % 3000, i % 3000);
+      s += buf;
+    }
+    picojson::string_pool growing;
+    opts.pool = &growing;
+    ndjson_lines grown;
+    bool same = picojson::parse_ndjson(s, grown, opts) == 0 && grown.lines.size() == 20000;
+    std::istringstream iss(s);
+    std::string line;
+    for (size_t i = 0; same && std::getline(iss, line); ++i) {
+      same = grown.values[i] == line;
+    }
+    _ok(same && growing.size() == (pooled != 0 ? 6000 : 0), "parse_ndjson with a growing string pool");
+#endif
+  }
+
+  {
+    picojson::hash_map<std::string, int> h1, h2;
+    picojson::sorted_flat_map<std::string, int> sm;
+    picojson::flat_map<std::string, int> fm;
+    for (int i = 0; i < 100; ++i) {
+      char key[16];
+      sprintf(key, "k%d", (i * 37) % 100);
+      h1[key] = i;
+      h2.insert(std::make_pair(std::string(key), i));
+      sm[key] = i;
+      fm[key] = i;
+    }
+    _ok(h1.size() == 100 && h1.find("k37") != h1.end() && h1.find("k37")->second == 1, "hash_map lookup");
+    _ok(h1.find("k100") == h1.end() && h1.count("k99") == 1, "hash_map miss");
+    _ok(h1.begin()->first == "k0" && (h1.begin() + 1)->first == "k37", "hash_map keeps insertion order");
+    _ok(!h2.insert(std::make_pair(std::string("k0"), 5)).second && h2["k0"] == 0, "hash_map insert of existing key");
+    _ok(h1 == h2, "hash_map equality");
+    h1.erase("k37");
+    _ok(h1.size() == 99 && h1.count("k37") == 0 && h1["k74"] == 2, "hash_map erase");
+    _ok(h1 != h2, "hash_map inequality");
+    _ok(sm.begin()->first == "k0" && (sm.begin() + 1)->first == "k1" && sm["k37"] == 1, "sorted_flat_map keeps keys sorted");
+    _ok((fm.begin() + 1)->first == "k37" && fm.at("k74") == 2, "flat_map keeps insertion order");
+    bool found = true;
+    for (int i = 0; i < 100; ++i) {
+      char key[16];
+      sprintf(key, "k%d", (i * 61) % 100);
+      h2.erase(key);
+      sm.erase(key);
+      for (picojson::sorted_flat_map<std::string, int>::iterator j = sm.begin(); j != sm.end(); ++j)
+        found = found && h2.find(j->first) != h2.end() && h2.find(j->first)->second == j->second;
+      found = found && h2.size() == sm.size() && h2.count(key) == 0;
+    }
+    _ok(found, "hash_map lookup after each erase");
+  }
+
+  {
+    picojson::document doc;
+    std::string s = "{\"a\":[1,\"a string that does not fit in SSO\",{\"b\":[]}],\"c\":\"d\"}";
+    _ok(picojson::parse(doc, s).empty(), "parse into document");
+    picojson::value v;
+    picojson::parse(v, s);
+    _ok(doc.root() == v, "document has the same tree as value");
+    _ok(doc.root().serialize() == s, "document serializes");
+    picojson::value copy = doc.root().get("a");
+    doc.root().get("a").get<picojson::array>().push_back(picojson::value("x"));
+    doc.root().get("c") = picojson::value(1.0);
+    _ok(picojson::parse(doc, "[true]").empty(), "reparse document");
+    _ok(doc.root().serialize() == "[true]", "reparsed document");
+    doc.clear();
+    _ok(copy.serialize() == "[1,\"a string that does not fit in SSO\",{\"b\":[]}]", "copy outlives document");
+    picojson::value swapped, moved;
+    {
+      picojson::document d;
+      picojson::parse(d, "{\"a\":[\"a string that does not fit in SSO\"],\"b\":{\"c\":[[1]],\"c\":\"not in SSO either\"}}");
+      swapped.swap(d.root().get("a"));
+#if PICOJSON_USE_RVALUE_REFERENCE
+      moved = std::move(d.root().get("b"));
+#else
+      moved = d.root().get("b");
+#endif
+      swapped.detach();
+      moved.detach();
+    }
+    _ok(swapped.serialize() == "[\"a string that does not fit in SSO\"]" && moved.serialize() == "{\"c\":\"not in SSO either\"}",
+        "values swapped or moved out of a document outlive it after detach()");
+    {
+      picojson::document d;
+      picojson::parse(d, "[\"a string that does not fit in SSO\",{\"b\":[1]},\"another string that does not fit\"]");
+      picojson::array &a = d.root().get<picojson::array>();
+      std::reverse(a.begin(), a.end());
+      a.push_back(picojson::value());
+      a.insert(a.begin(), picojson::value(true));
+      _ok(d.root().serialize() == "[true,\"another string that does not fit\",{\"b\":[1]},\"a string that does not fit in SSO\",null]",
+          "values swapped or moved within a document");
+#if PICOJSON_USE_RVALUE_REFERENCE && __cplusplus >= 201103L
+      _ok(noexcept(a[0].swap(a[1])), "swap is noexcept");
+#endif
+    }
+  }
+
   {
     std::string s = "[{\"a\":123}]", err;
     picojson::null_parse_context ctx(1);